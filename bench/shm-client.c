@@ -0,0 +1,269 @@
+/* A minimal Wayland client for the end-to-end benchmarks. It maps an
+   xdg_toplevel backed by wl_shm buffers, and draws a new frame every time
+   the compositor asks for one, until it gets disconnected or killed.
+
+   Usage: bench-shm-client [width height] */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <wayland-client.h>
+
+#include "xdg-shell-client-protocol.h"
+
+
+#define BUFFER_COUNT 2
+
+
+typedef struct {
+    struct wl_buffer *wl_buffer;
+    uint32_t *pixels;
+    int busy;
+} client_buffer_t;
+
+typedef struct {
+    struct wl_display *display;
+    struct wl_compositor *compositor;
+    struct wl_shm *shm;
+    struct xdg_wm_base *wm_base;
+    struct wl_surface *surface;
+    struct xdg_surface *xdg_surface;
+    struct xdg_toplevel *xdg_toplevel;
+    client_buffer_t buffers[BUFFER_COUNT];
+    int width;
+    int height;
+    int configured;
+    uint32_t frame_count;
+} client_t;
+
+
+static void client_draw_frame(client_t *client);
+
+
+static void handle_buffer_release(void *data, struct wl_buffer *wl_buffer)
+{
+    (void)wl_buffer;
+    client_buffer_t *buffer = data;
+    buffer->busy = 0;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+    .release = handle_buffer_release,
+};
+
+
+static void handle_frame_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+    (void)time;
+    wl_callback_destroy(callback);
+    client_draw_frame(data);
+}
+
+static const struct wl_callback_listener frame_listener = {
+    .done = handle_frame_done,
+};
+
+
+static void client_draw_frame(client_t *client)
+{
+    client_buffer_t *buffer = NULL;
+
+    for (int i = 0; i < BUFFER_COUNT; i++) {
+        if (!client->buffers[i].busy) {
+            buffer = &client->buffers[i];
+            break;
+        }
+    }
+
+    struct wl_callback *callback = wl_surface_frame(client->surface);
+    wl_callback_add_listener(callback, &frame_listener, client);
+
+    if (buffer) {
+        /* Cycle through shades of gray, so that every frame damages the whole surface */
+        uint32_t shade = client->frame_count & 0xff;
+        uint32_t color = 0xff000000 | (shade << 16) | (shade << 8) | shade;
+        size_t pixel_count = (size_t)client->width * client->height;
+        for (size_t i = 0; i < pixel_count; i++) {
+            buffer->pixels[i] = color;
+        }
+        wl_surface_attach(client->surface, buffer->wl_buffer, 0, 0);
+        wl_surface_damage_buffer(client->surface, 0, 0, client->width, client->height);
+        buffer->busy = 1;
+        client->frame_count++;
+    }
+
+    wl_surface_commit(client->surface);
+}
+
+
+static int client_create_buffers(client_t *client)
+{
+    int stride = client->width * 4;
+    size_t buffer_size = (size_t)stride * client->height;
+    size_t pool_size = buffer_size * BUFFER_COUNT;
+
+    int fd = memfd_create("bench-shm-client", MFD_CLOEXEC);
+    if (fd < 0) {
+        perror("memfd_create");
+        return -1;
+    }
+    if (ftruncate(fd, pool_size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return -1;
+    }
+    uint8_t *data = mmap(NULL, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == data) {
+        perror("mmap");
+        close(fd);
+        return -1;
+    }
+
+    struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, pool_size);
+    for (int i = 0; i < BUFFER_COUNT; i++) {
+        client_buffer_t *buffer = &client->buffers[i];
+        buffer->wl_buffer = wl_shm_pool_create_buffer(pool, buffer_size * i,
+                                                      client->width, client->height,
+                                                      stride, WL_SHM_FORMAT_ARGB8888);
+        buffer->pixels = (uint32_t *)(data + buffer_size * i);
+        buffer->busy = 0;
+        wl_buffer_add_listener(buffer->wl_buffer, &buffer_listener, buffer);
+    }
+    wl_shm_pool_destroy(pool);
+    close(fd);
+    return 0;
+}
+
+
+static void handle_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial)
+{
+    client_t *client = data;
+
+    xdg_surface_ack_configure(xdg_surface, serial);
+    if (!client->configured) {
+        client->configured = 1;
+        client_draw_frame(client);
+    }
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+    .configure = handle_xdg_surface_configure,
+};
+
+
+static void handle_xdg_toplevel_configure(void *data, struct xdg_toplevel *xdg_toplevel,
+                                          int32_t width, int32_t height, struct wl_array *states)
+{
+    /* The buffer size is fixed, whatever the compositor asks for */
+    (void)data;
+    (void)xdg_toplevel;
+    (void)width;
+    (void)height;
+    (void)states;
+}
+
+
+static void handle_xdg_toplevel_close(void *data, struct xdg_toplevel *xdg_toplevel)
+{
+    (void)data;
+    (void)xdg_toplevel;
+    exit(0);
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+    .configure = handle_xdg_toplevel_configure,
+    .close = handle_xdg_toplevel_close,
+};
+
+
+static void handle_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+    (void)data;
+    xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+    .ping = handle_wm_base_ping,
+};
+
+
+static void handle_registry_global(void *data, struct wl_registry *registry,
+                                   uint32_t name, const char *interface, uint32_t version)
+{
+    (void)version;
+    client_t *client = data;
+
+    if (!strcmp(interface, wl_compositor_interface.name)) {
+        client->compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+    } else if (!strcmp(interface, wl_shm_interface.name)) {
+        client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+    } else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+        client->wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+        xdg_wm_base_add_listener(client->wm_base, &wm_base_listener, client);
+    }
+}
+
+
+static void handle_registry_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+    (void)data;
+    (void)registry;
+    (void)name;
+}
+
+static const struct wl_registry_listener registry_listener = {
+    .global = handle_registry_global,
+    .global_remove = handle_registry_global_remove,
+};
+
+
+int main(int argc, char *argv[])
+{
+    client_t client;
+
+    memset(&client, 0, sizeof(client));
+    client.width = argc > 2 ? atoi(argv[1]) : 256;
+    client.height = argc > 2 ? atoi(argv[2]) : 256;
+    if (client.width <= 0 || client.height <= 0) {
+        fprintf(stderr, "invalid size: %dx%d\n", client.width, client.height);
+        return 1;
+    }
+
+    client.display = wl_display_connect(NULL);
+    if (!client.display) {
+        fprintf(stderr, "failed to connect to the Wayland display\n");
+        return 1;
+    }
+
+    struct wl_registry *registry = wl_display_get_registry(client.display);
+    wl_registry_add_listener(registry, &registry_listener, &client);
+    wl_display_roundtrip(client.display);
+    if (!client.compositor || !client.shm || !client.wm_base) {
+        fprintf(stderr, "missing globals from the compositor\n");
+        return 1;
+    }
+
+    if (client_create_buffers(&client) < 0) {
+        return 1;
+    }
+
+    client.surface = wl_compositor_create_surface(client.compositor);
+    client.xdg_surface = xdg_wm_base_get_xdg_surface(client.wm_base, client.surface);
+    xdg_surface_add_listener(client.xdg_surface, &xdg_surface_listener, &client);
+    client.xdg_toplevel = xdg_surface_get_toplevel(client.xdg_surface);
+    xdg_toplevel_add_listener(client.xdg_toplevel, &xdg_toplevel_listener, &client);
+    xdg_toplevel_set_title(client.xdg_toplevel, "bench-shm-client");
+    wl_surface_commit(client.surface);
+
+    while (wl_display_dispatch(client.display) != -1) {
+        /* Everything happens in the listeners */
+    }
+
+    wl_display_disconnect(client.display);
+    return 0;
+}
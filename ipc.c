@@ -0,0 +1,542 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <janet.h>
+
+#include <wayland-server-core.h>
+
+#include "jl.h"
+#include "types.h"
+
+
+#ifndef MOD_NAME
+#define MOD_NAME IPC_MOD_NAME
+#endif
+
+
+/* Every message is prefixed with its payload length, as a 32-bit
+   big-endian unsigned integer. */
+#define JIPC_HEADER_SIZE 4
+#define JIPC_READ_CHUNK_SIZE 16384
+/* Limit the reads done in one callback, so that a flooding client can not
+   starve the rest of the event loop. The fd is level-triggered, we will be
+   called again for the remaining data. */
+#define JIPC_MAX_READS_PER_DISPATCH 16
+#define JIPC_DEFAULT_MAX_MSG_SIZE (1024 * 1024)
+
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} jipc_buf_t;
+
+typedef struct {
+    int fd;
+    struct wl_event_source *event_source;
+    struct wl_event_loop *event_loop;
+    JanetFunction *handler_fn;
+    const uint8_t *path;
+    uint32_t max_msg_size;
+    struct wl_list conns;
+} jipc_server_t;
+
+typedef struct {
+    int fd;
+    struct wl_event_source *event_source;
+    jipc_server_t *server;
+    struct wl_list link;
+    jipc_buf_t rbuf;
+    jipc_buf_t wbuf;
+    size_t wbuf_pos;
+    int writable_armed;
+    int in_dispatch;
+} jipc_conn_t;
+
+
+static int method_ipc_server_gcmark(void *p, size_t len)
+{
+    (void)len;
+    jipc_server_t *server = (jipc_server_t *)p;
+
+    if (server->handler_fn) {
+        janet_mark(janet_wrap_function(server->handler_fn));
+    }
+    if (server->path) {
+        janet_mark(janet_wrap_string(server->path));
+    }
+
+    return 0;
+}
+
+static const JanetAbstractType jipc_at_ipc_server = {
+    .name = MOD_NAME "/ipc-server",
+    .gc = JL_STATS_GC,
+    .gcmark = method_ipc_server_gcmark,
+    JANET_ATEND_GCMARK
+};
+
+
+static void jipc_buf_free(jipc_buf_t *buf)
+{
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+static void jipc_buf_reserve(jipc_buf_t *buf, size_t extra)
+{
+    size_t needed = buf->len + extra;
+    size_t cap = buf->cap ? buf->cap : JIPC_READ_CHUNK_SIZE;
+    uint8_t *data;
+
+    if (needed <= buf->cap) {
+        return;
+    }
+    while (cap < needed) {
+        cap *= 2;
+    }
+    data = realloc(buf->data, cap);
+    if (!data) {
+        JANET_OUT_OF_MEMORY;
+    }
+    buf->data = data;
+    buf->cap = cap;
+}
+
+
+static int method_ipc_conn_gc(void *p, size_t len)
+{
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    jipc_conn_t *conn = (jipc_conn_t *)p;
+
+    jipc_buf_free(&conn->rbuf);
+    jipc_buf_free(&conn->wbuf);
+
+    return 0;
+}
+
+static int method_ipc_conn_gcmark(void *p, size_t len)
+{
+    (void)len;
+    jipc_conn_t *conn = (jipc_conn_t *)p;
+
+    if (conn->server) {
+        janet_mark(janet_wrap_abstract(conn->server));
+    }
+
+    return 0;
+}
+
+static const JanetAbstractType jipc_at_ipc_conn = {
+    .name = MOD_NAME "/ipc-conn",
+    .gc = method_ipc_conn_gc,
+    .gcmark = method_ipc_conn_gcmark,
+    JANET_ATEND_GCMARK
+};
+
+
+static void jipc_conn_close(jipc_conn_t *conn)
+{
+    if (conn->fd < 0) {
+        return;
+    }
+
+    wl_event_source_remove(conn->event_source);
+    conn->event_source = NULL;
+    close(conn->fd);
+    conn->fd = -1;
+    wl_list_remove(&conn->link);
+    wl_list_init(&conn->link);
+
+    jipc_buf_free(&conn->rbuf);
+    jipc_buf_free(&conn->wbuf);
+    conn->wbuf_pos = 0;
+
+    janet_gcunroot(janet_wrap_abstract(conn));
+}
+
+
+/* Returns -1 on error, 0 when the connection is still open */
+static int jipc_conn_flush(jipc_conn_t *conn)
+{
+    jipc_buf_t *wbuf = &conn->wbuf;
+
+    while (conn->wbuf_pos < wbuf->len) {
+        ssize_t n = send(conn->fd, wbuf->data + conn->wbuf_pos, wbuf->len - conn->wbuf_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            } else if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                break;
+            }
+            return -1;
+        }
+        conn->wbuf_pos += n;
+    }
+
+    if (conn->wbuf_pos >= wbuf->len) {
+        wbuf->len = 0;
+        conn->wbuf_pos = 0;
+        if (conn->writable_armed) {
+            wl_event_source_fd_update(conn->event_source, WL_EVENT_READABLE);
+            conn->writable_armed = 0;
+        }
+    } else if (!(conn->writable_armed)) {
+        wl_event_source_fd_update(conn->event_source, WL_EVENT_READABLE | WL_EVENT_WRITABLE);
+        conn->writable_armed = 1;
+    }
+
+    return 0;
+}
+
+
+static void jipc_conn_queue(jipc_conn_t *conn, const uint8_t *data, int32_t len)
+{
+    jipc_buf_t *wbuf = &conn->wbuf;
+    uint8_t *header;
+
+    jipc_buf_reserve(wbuf, JIPC_HEADER_SIZE + len);
+    header = wbuf->data + wbuf->len;
+    header[0] = (len >> 24) & 0xff;
+    header[1] = (len >> 16) & 0xff;
+    header[2] = (len >> 8) & 0xff;
+    header[3] = len & 0xff;
+    memcpy(header + JIPC_HEADER_SIZE, data, len);
+    wbuf->len += JIPC_HEADER_SIZE + len;
+}
+
+
+/* Returns -1 on error, 1 when the peer closed the connection, 0 otherwise */
+static int jipc_conn_drain(jipc_conn_t *conn)
+{
+    jipc_buf_t *rbuf = &conn->rbuf;
+
+    for (int i = 0; i < JIPC_MAX_READS_PER_DISPATCH; i++) {
+        jipc_buf_reserve(rbuf, JIPC_READ_CHUNK_SIZE);
+        ssize_t n = recv(conn->fd, rbuf->data + rbuf->len, rbuf->cap - rbuf->len, 0);
+        if (n < 0) {
+            if (EINTR == errno) {
+                continue;
+            } else if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                return 0;
+            }
+            return -1;
+        } else if (0 == n) {
+            return 1;
+        }
+        rbuf->len += n;
+    }
+
+    return 0;
+}
+
+
+/* Calls the handler for every complete message in the read buffer. The
+   handler may close the connection, so conn->fd is checked after every call. */
+static void jipc_conn_dispatch(jipc_conn_t *conn)
+{
+    jipc_buf_t *rbuf = &conn->rbuf;
+    size_t pos = 0;
+
+    while (rbuf->len - pos >= JIPC_HEADER_SIZE) {
+        const uint8_t *header = rbuf->data + pos;
+        uint32_t msg_size = ((uint32_t)header[0] << 24) |
+            ((uint32_t)header[1] << 16) |
+            ((uint32_t)header[2] << 8) |
+            (uint32_t)header[3];
+
+        if (msg_size > conn->server->max_msg_size) {
+            janet_eprintf("ipc message too large (%d bytes), closing connection\n", (int32_t)msg_size);
+            jipc_conn_close(conn);
+            return;
+        }
+        if (rbuf->len - pos - JIPC_HEADER_SIZE < msg_size) {
+            break;
+        }
+
+        Janet argv[] = {
+            janet_wrap_abstract(conn),
+            janet_wrap_string(janet_string(header + JIPC_HEADER_SIZE, msg_size)),
+        };
+        Janet ret = janet_wrap_nil();
+        JanetFiber *fiber = NULL;
+
+        pos += JIPC_HEADER_SIZE + msg_size;
+
+        int locked = janet_gclock();
+        int sig = janet_pcall(conn->server->handler_fn, 2, argv, &ret, &fiber);
+        janet_gcunlock(locked);
+
+        if (conn->fd < 0) {
+            return;
+        }
+        if (JANET_SIGNAL_OK != sig) {
+            janet_stacktrace(fiber, ret);
+        } else if (janet_checktypes(ret, JANET_TFLAG_BYTES)) {
+            const uint8_t *reply;
+            int32_t reply_len;
+            janet_bytes_view(ret, &reply, &reply_len);
+            jipc_conn_queue(conn, reply, reply_len);
+        } else if (!janet_checktype(ret, JANET_NIL)) {
+            janet_eprintf("ignoring non-bytes return value from ipc handler: %v\n", ret);
+        }
+    }
+
+    if (pos > 0) {
+        memmove(rbuf->data, rbuf->data + pos, rbuf->len - pos);
+        rbuf->len -= pos;
+    }
+}
+
+
+static int jipc_conn_fd_callback(int fd, uint32_t mask, void *data)
+{
+    (void)fd;
+    jipc_conn_t *conn = data;
+    int eof = 0;
+
+    if (mask & WL_EVENT_READABLE) {
+        int ret = jipc_conn_drain(conn);
+        if (ret < 0) {
+            jipc_conn_close(conn);
+            return 0;
+        }
+        eof = ret;
+
+        /* Replies are only queued while dispatching, and sent in one go below */
+        conn->in_dispatch = 1;
+        jipc_conn_dispatch(conn);
+        conn->in_dispatch = 0;
+        if (conn->fd < 0) {
+            return 0;
+        }
+    }
+
+    if (conn->wbuf.len > 0 && jipc_conn_flush(conn) < 0) {
+        jipc_conn_close(conn);
+        return 0;
+    }
+
+    if (eof || (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR))) {
+        jipc_conn_close(conn);
+    }
+
+    return 0;
+}
+
+
+static int jipc_server_fd_callback(int fd, uint32_t mask, void *data)
+{
+    (void)mask;
+    jipc_server_t *server = data;
+
+    for (;;) {
+        int conn_fd = accept(fd, NULL, NULL);
+        if (conn_fd < 0) {
+            if (EINTR == errno) {
+                continue;
+            } else if (EAGAIN != errno && EWOULDBLOCK != errno) {
+                janet_eprintf("failed to accept ipc connection: %d\n", errno);
+            }
+            break;
+        }
+
+        if (fcntl(conn_fd, F_SETFL, fcntl(conn_fd, F_GETFL) | O_NONBLOCK) < 0 ||
+            fcntl(conn_fd, F_SETFD, FD_CLOEXEC) < 0) {
+            janet_eprintf("failed to set up ipc connection: %d\n", errno);
+            close(conn_fd);
+            continue;
+        }
+
+        jipc_conn_t *conn = janet_abstract(&jipc_at_ipc_conn, sizeof(*conn));
+        memset(conn, 0, sizeof(*conn));
+        wl_list_init(&conn->link);
+        conn->fd = conn_fd;
+        conn->server = server;
+        conn->event_source = wl_event_loop_add_fd(server->event_loop, conn_fd, WL_EVENT_READABLE,
+                                                  jipc_conn_fd_callback, conn);
+        if (!(conn->event_source)) {
+            janet_eprintf("failed to add ipc connection to wayland event loop\n");
+            close(conn_fd);
+            conn->fd = -1;
+            continue;
+        }
+
+        wl_list_insert(&server->conns, &conn->link);
+        janet_gcroot(janet_wrap_abstract(conn));
+    }
+
+    return 0;
+}
+
+
+static Janet cfun_ipc_server_create(int32_t argc, Janet *argv)
+{
+    struct wl_event_loop *event_loop;
+    const uint8_t *path;
+    JanetFunction *handler_fn;
+    int32_t max_msg_size;
+
+    struct sockaddr_un addr;
+    int fd;
+    jipc_server_t *server;
+
+    janet_arity(argc, 3, 4);
+
+    event_loop = jl_get_abs_obj_pointer_by_name(argv, 0, WL_MOD_NAME "/wl-event-loop");
+    path = janet_getstring(argv, 1);
+    handler_fn = janet_getfunction(argv, 2);
+    max_msg_size = janet_optnat(argv, argc, 3, JIPC_DEFAULT_MAX_MSG_SIZE);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ((size_t)janet_string_length(path) >= sizeof(addr.sun_path)) {
+        janet_panicf("socket path too long: %v", argv[1]);
+    }
+    memcpy(addr.sun_path, path, janet_string_length(path));
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        janet_panicf("failed to create ipc socket: %d", errno);
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        close(fd);
+        janet_panicf("failed to bind ipc socket %v: %d", argv[1], err);
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        int err = errno;
+        close(fd);
+        unlink((const char *)path);
+        janet_panicf("failed to listen on ipc socket %v: %d", argv[1], err);
+    }
+
+    server = janet_abstract(&jipc_at_ipc_server, sizeof(*server));
+    memset(server, 0, sizeof(*server));
+    wl_list_init(&server->conns);
+    server->fd = fd;
+    server->event_loop = event_loop;
+    server->handler_fn = handler_fn;
+    server->path = path;
+    server->max_msg_size = max_msg_size;
+
+    server->event_source = wl_event_loop_add_fd(event_loop, fd, WL_EVENT_READABLE,
+                                                jipc_server_fd_callback, server);
+    if (!(server->event_source)) {
+        close(fd);
+        unlink((const char *)path);
+        janet_panic("failed to add ipc socket to wayland event loop");
+    }
+
+    janet_gcroot(janet_wrap_abstract(server));
+    return janet_wrap_abstract(server);
+}
+
+
+static Janet cfun_ipc_server_destroy(int32_t argc, Janet *argv)
+{
+    jipc_server_t *server;
+
+    jipc_conn_t *conn, *tmp;
+
+    janet_fixarity(argc, 1);
+
+    server = janet_getabstract(argv, 0, &jipc_at_ipc_server);
+    if (server->fd < 0) {
+        return janet_wrap_nil();
+    }
+
+    wl_list_for_each_safe(conn, tmp, &server->conns, link) {
+        jipc_conn_close(conn);
+    }
+
+    wl_event_source_remove(server->event_source);
+    server->event_source = NULL;
+    close(server->fd);
+    server->fd = -1;
+    unlink((const char *)server->path);
+
+    janet_gcunroot(janet_wrap_abstract(server));
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_ipc_send(int32_t argc, Janet *argv)
+{
+    jipc_conn_t *conn;
+    JanetByteView msg;
+
+    janet_fixarity(argc, 2);
+
+    conn = janet_getabstract(argv, 0, &jipc_at_ipc_conn);
+    msg = janet_getbytes(argv, 1);
+
+    if (conn->fd < 0) {
+        janet_panic("ipc connection is closed");
+    }
+
+    jipc_conn_queue(conn, msg.bytes, msg.len);
+    if (!(conn->in_dispatch) && jipc_conn_flush(conn) < 0) {
+        jipc_conn_close(conn);
+        return janet_wrap_false();
+    }
+    return janet_wrap_true();
+}
+
+
+static Janet cfun_ipc_conn_close(int32_t argc, Janet *argv)
+{
+    jipc_conn_t *conn;
+
+    janet_fixarity(argc, 1);
+
+    conn = janet_getabstract(argv, 0, &jipc_at_ipc_conn);
+    jipc_conn_close(conn);
+    return janet_wrap_nil();
+}
+
+
+static JanetReg cfuns[] = {
+    {
+        "ipc-server-create", cfun_ipc_server_create,
+        "(" MOD_NAME "/ipc-server-create wl-event-loop path handler &opt max-msg-size)\n\n"
+        "Creates a Unix socket IPC server, and adds it to a wayland event loop. "
+        "Every message is prefixed with its length, as a 32-bit big-endian integer. "
+        "Handler is called as (handler conn msg) for every complete message. "
+        "If handler returns a string or buffer, it is sent back as the reply."
+    },
+    {
+        "ipc-server-destroy", cfun_ipc_server_destroy,
+        "(" MOD_NAME "/ipc-server-destroy ipc-server)\n\n"
+        "Closes all connections of an IPC server, and removes the socket file."
+    },
+    {
+        "ipc-send", cfun_ipc_send,
+        "(" MOD_NAME "/ipc-send ipc-conn msg)\n\n"
+        "Queues a message to be sent to an IPC client. Returns false if the "
+        "connection got closed due to an error."
+    },
+    {
+        "ipc-conn-close", cfun_ipc_conn_close,
+        "(" MOD_NAME "/ipc-conn-close ipc-conn)\n\n"
+        "Closes an IPC connection."
+    },
+    {NULL, NULL, NULL},
+};
+
+
+JANET_MODULE_ENTRY(JanetTable *env)
+{
+    janet_register_abstract_type(&jipc_at_ipc_server);
+    janet_register_abstract_type(&jipc_at_ipc_conn);
+
+    jl_cfuns(env, MOD_NAME, cfuns);
+}
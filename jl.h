@@ -1,6 +1,8 @@
 #ifndef __JL_H__
 #define __JL_H__
 
+#include "stats.h"
+
 
 #define WL_MOD_NAME "wl"
 #define WL_MOD_FULL_NAME "janetland/wl"
@@ -12,6 +14,8 @@
 #define XCB_MOD_FULL_NAME "janetland/xcb"
 #define UTIL_MOD_NAME "util"
 #define UTIL_MOD_FULL_NAME "janetland/util"
+#define IPC_MOD_NAME "ipc"
+#define IPC_MOD_FULL_NAME "janetland/ipc"
 
 
 #define jl_log(verb, fmt, ...) \
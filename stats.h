@@ -0,0 +1,261 @@
+#ifndef __JL_STATS_H__
+#define __JL_STATS_H__
+
+
+/* Opt-in accounting of abstract objects and cfun calls, compiled in with
+   -DJL_STATS (export JL_STATS=1 before running jpm). Every module counts,
+   per thread, the abstract objects it allocates and the ones that get
+   collected, by type, along with the calls to each of its cfuns. The
+   numbers are gathered from all loaded modules by util/stats.
+
+   Threaded abstract objects are left out, since the counters are per
+   thread, and janet_abstract_threaded() objects may be collected on any
+   thread that holds a reference.
+
+   Without JL_STATS, JL_STATS_GC is NULL, JL_STATS_COUNT_GC() is a no-op,
+   and jl_cfuns() is plain janet_cfuns(). */
+
+#ifdef JL_STATS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/* Both must be powers of two */
+#define JL_STATS_TYPE_SLOTS 256
+#define JL_STATS_MAX_CFUNS 256
+
+typedef struct {
+    const JanetAbstractType *at;
+    uint64_t created;
+    uint64_t collected;
+    uint64_t bytes;
+} jl_stats_type_entry_t;
+
+static JANET_THREAD_LOCAL jl_stats_type_entry_t jl_stats_types[JL_STATS_TYPE_SLOTS];
+static JANET_THREAD_LOCAL uint64_t jl_stats_cfun_calls[JL_STATS_MAX_CFUNS];
+
+/* Set once when the module gets loaded */
+static const JanetReg *jl_stats_cfun_regs = NULL;
+static int32_t jl_stats_cfun_count = 0;
+static const char *jl_stats_cfun_prefix = NULL;
+
+
+static inline jl_stats_type_entry_t *jl_stats_get_type_entry(const JanetAbstractType *at)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)at * 0x9e3779b97f4a7c15ULL;
+    size_t i = (size_t)(hash >> 32) & (JL_STATS_TYPE_SLOTS - 1);
+
+    for (size_t n = 0; n < JL_STATS_TYPE_SLOTS; n++, i = (i + 1) & (JL_STATS_TYPE_SLOTS - 1)) {
+        jl_stats_type_entry_t *entry = &jl_stats_types[i];
+        if (entry->at == at) {
+            return entry;
+        }
+        if (!entry->at) {
+            entry->at = at;
+            return entry;
+        }
+    }
+    /* Too many types, stop counting new ones */
+    return NULL;
+}
+
+
+static inline void *jl_stats_abstract(const JanetAbstractType *at, size_t size)
+{
+    jl_stats_type_entry_t *entry = jl_stats_get_type_entry(at);
+    if (entry) {
+        entry->created++;
+        entry->bytes += size;
+    }
+    /* The parentheses keep the macro below from expanding */
+    return (janet_abstract)(at, size);
+}
+
+/* Counts every abstract object allocated in this module, including the
+   wrappers from jl_pointer_to_abs_obj() */
+#define janet_abstract(at, size) jl_stats_abstract((at), (size))
+
+
+static inline void jl_stats_count_gc(void *p)
+{
+    jl_stats_type_entry_t *entry = jl_stats_get_type_entry(janet_abstract_head(p)->type);
+    if (entry) {
+        entry->collected++;
+    }
+}
+
+static int jl_stats_gc(void *p, size_t len)
+{
+    (void)len;
+    jl_stats_count_gc(p);
+    return 0;
+}
+
+/* For abstract types without a gc method of their own */
+#define JL_STATS_GC jl_stats_gc
+/* For the gc methods of the other abstract types */
+#define JL_STATS_COUNT_GC(p) jl_stats_count_gc(p)
+
+
+/* Janet cfuns carry no context, so the calls are counted by a fixed set of
+   trampolines, one for each entry in the module's cfun table */
+#define JL_STATS_TRAMPOLINE_ROW(X, h) \
+    X(0x##h##0) X(0x##h##1) X(0x##h##2) X(0x##h##3) \
+    X(0x##h##4) X(0x##h##5) X(0x##h##6) X(0x##h##7) \
+    X(0x##h##8) X(0x##h##9) X(0x##h##A) X(0x##h##B) \
+    X(0x##h##C) X(0x##h##D) X(0x##h##E) X(0x##h##F)
+
+#define JL_STATS_TRAMPOLINES(X) \
+    JL_STATS_TRAMPOLINE_ROW(X, 0) JL_STATS_TRAMPOLINE_ROW(X, 1) \
+    JL_STATS_TRAMPOLINE_ROW(X, 2) JL_STATS_TRAMPOLINE_ROW(X, 3) \
+    JL_STATS_TRAMPOLINE_ROW(X, 4) JL_STATS_TRAMPOLINE_ROW(X, 5) \
+    JL_STATS_TRAMPOLINE_ROW(X, 6) JL_STATS_TRAMPOLINE_ROW(X, 7) \
+    JL_STATS_TRAMPOLINE_ROW(X, 8) JL_STATS_TRAMPOLINE_ROW(X, 9) \
+    JL_STATS_TRAMPOLINE_ROW(X, A) JL_STATS_TRAMPOLINE_ROW(X, B) \
+    JL_STATS_TRAMPOLINE_ROW(X, C) JL_STATS_TRAMPOLINE_ROW(X, D) \
+    JL_STATS_TRAMPOLINE_ROW(X, E) JL_STATS_TRAMPOLINE_ROW(X, F)
+
+#define JL_STATS_DEFINE_TRAMPOLINE(n) \
+    static Janet jl_stats_trampoline_##n(int32_t argc, Janet *argv) \
+    { \
+        jl_stats_cfun_calls[n]++; \
+        return jl_stats_cfun_regs[n].cfun(argc, argv); \
+    }
+
+#define JL_STATS_TRAMPOLINE_POINTER(n) jl_stats_trampoline_##n,
+
+JL_STATS_TRAMPOLINES(JL_STATS_DEFINE_TRAMPOLINE)
+
+static const JanetCFunction jl_stats_trampolines[JL_STATS_MAX_CFUNS] = {
+    JL_STATS_TRAMPOLINES(JL_STATS_TRAMPOLINE_POINTER)
+};
+
+
+static inline void jl_stats_table_add(JanetTable *table, const char *key, uint64_t n)
+{
+    Janet k = janet_ckeywordv(key);
+    Janet v = janet_table_get(table, k);
+    double prev = janet_checktype(v, JANET_NUMBER) ? janet_unwrap_number(v) : 0;
+    janet_table_put(table, k, janet_wrap_number(prev + (double)n));
+}
+
+
+static inline JanetTable *jl_stats_table_child(JanetTable *table, Janet key)
+{
+    Janet v = janet_table_get(table, key);
+    if (janet_checktype(v, JANET_TABLE)) {
+        return janet_unwrap_table(v);
+    }
+    JanetTable *child = janet_table(4);
+    janet_table_put(table, key, janet_wrap_table(child));
+    return child;
+}
+
+
+/* The module's entry point for util/stats, called on an instance of
+   jl_stats_source_at. With no arguments, resets the counters, otherwise
+   adds them to the tables in argv[0] (abstract types) and argv[1] (cfuns),
+   merging with what other modules already put there. */
+static Janet jl_stats_source_call(void *p, int32_t argc, Janet *argv)
+{
+    (void)p;
+
+    if (0 == argc) {
+        for (size_t i = 0; i < JL_STATS_TYPE_SLOTS; i++) {
+            jl_stats_types[i].created = 0;
+            jl_stats_types[i].collected = 0;
+            jl_stats_types[i].bytes = 0;
+        }
+        memset(jl_stats_cfun_calls, 0, sizeof(jl_stats_cfun_calls));
+        return janet_wrap_nil();
+    }
+
+    janet_fixarity(argc, 2);
+
+    JanetTable *types = janet_gettable(argv, 0);
+    JanetTable *cfuns = janet_gettable(argv, 1);
+
+    for (size_t i = 0; i < JL_STATS_TYPE_SLOTS; i++) {
+        jl_stats_type_entry_t *entry = &jl_stats_types[i];
+        if (!entry->at || (!entry->created && !entry->collected)) {
+            continue;
+        }
+        JanetTable *t = jl_stats_table_child(types, janet_cstringv(entry->at->name));
+        jl_stats_table_add(t, "created", entry->created);
+        jl_stats_table_add(t, "collected", entry->collected);
+        jl_stats_table_add(t, "bytes", entry->bytes);
+    }
+
+    for (int32_t i = 0; i < jl_stats_cfun_count; i++) {
+        if (!jl_stats_cfun_calls[i]) {
+            continue;
+        }
+        char name[256];
+        snprintf(name, sizeof(name), "%s/%s", jl_stats_cfun_prefix, jl_stats_cfun_regs[i].name);
+        janet_table_put(cfuns, janet_cstringv(name), janet_wrap_number((double)jl_stats_cfun_calls[i]));
+    }
+
+    return janet_wrap_nil();
+}
+
+
+static char jl_stats_source_name[64];
+
+/* Native modules are loaded separately, and don't share any C symbols or
+   Janet environments, so util can't reach the counters of other modules
+   directly. The abstract type registry is the one place they all share:
+   each module registers a MOD_NAME "/stats-source" type, and util looks it
+   up by name, creates an instance, and calls it like a function. */
+static JanetAbstractType jl_stats_source_at = {
+    .name = jl_stats_source_name,
+    .call = jl_stats_source_call,
+    JANET_ATEND_CALL
+};
+
+
+static inline void jl_stats_cfuns(JanetTable *env, const char *regprefix, const JanetReg *cfuns)
+{
+    static JanetReg wrapped[JL_STATS_MAX_CFUNS + 1];
+    int32_t count = 0;
+
+    while (cfuns[count].name) {
+        count++;
+    }
+    if (count > JL_STATS_MAX_CFUNS) {
+        fprintf(stderr, "%s: too many cfuns for JL_STATS, only the first %d are counted\n",
+                regprefix, JL_STATS_MAX_CFUNS);
+    }
+
+    /* Registered as is, with the trampolines in place of the counted ones */
+    for (int32_t i = 0; i < count && i < JL_STATS_MAX_CFUNS; i++) {
+        wrapped[i] = cfuns[i];
+        wrapped[i].cfun = jl_stats_trampolines[i];
+    }
+    wrapped[count < JL_STATS_MAX_CFUNS ? count : JL_STATS_MAX_CFUNS] = (JanetReg){NULL, NULL, NULL};
+
+    jl_stats_cfun_regs = cfuns;
+    jl_stats_cfun_count = count < JL_STATS_MAX_CFUNS ? count : JL_STATS_MAX_CFUNS;
+    jl_stats_cfun_prefix = regprefix;
+    janet_cfuns(env, regprefix, wrapped);
+    if (count > JL_STATS_MAX_CFUNS) {
+        janet_cfuns(env, regprefix, &cfuns[JL_STATS_MAX_CFUNS]);
+    }
+
+    snprintf(jl_stats_source_name, sizeof(jl_stats_source_name), "%s/stats-source", regprefix);
+    janet_register_abstract_type(&jl_stats_source_at);
+}
+
+#define jl_cfuns(env, regprefix, cfuns) jl_stats_cfuns((env), (regprefix), (cfuns))
+
+#else
+
+#define JL_STATS_GC NULL
+#define JL_STATS_COUNT_GC(p) ((void)(p))
+#define jl_cfuns(env, regprefix, cfuns) janet_cfuns((env), (regprefix), (cfuns))
+
+#endif
+
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef __JL_TRACE_H__
+#define __JL_TRACE_H__
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <janet.h>
+#include "jl.h"
+
+
+/* A fixed-size ring of trace events, shared by all janetland modules. The
+   ring itself is created by the util module, and handed to the other
+   modules from Janet code. Writers claim slots with an atomic counter, so
+   recording never blocks, and the oldest events get overwritten. */
+
+typedef struct {
+    /* Index + 1 of the event stored in this slot, 0 while being written */
+    _Atomic uint64_t seq;
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+    /* Must point to strings that never get freed */
+    const char *cat;
+    const char *name;
+    uint32_t tid;
+} jl_trace_event_t;
+
+typedef struct {
+    _Atomic uint64_t head;
+    uint64_t mask;
+    jl_trace_event_t *events;
+} jl_trace_ring_t;
+
+
+static inline uint64_t jl_trace_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static inline uint32_t jl_trace_tid(void)
+{
+    static _Thread_local uint32_t tid = 0;
+    if (!tid) {
+        tid = (uint32_t)syscall(SYS_gettid);
+    }
+    return tid;
+}
+
+static inline void jl_trace_record(jl_trace_ring_t *ring,
+                                   const char *cat, const char *name,
+                                   uint64_t start_ns, uint64_t end_ns)
+{
+    uint64_t i = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+    jl_trace_event_t *ev = &ring->events[i & ring->mask];
+
+    atomic_store_explicit(&ev->seq, 0, memory_order_relaxed);
+    /* Keeps the payload stores below from being seen before the 0 */
+    atomic_thread_fence(memory_order_release);
+    ev->ts_ns = start_ns;
+    ev->dur_ns = end_ns - start_ns;
+    ev->cat = cat;
+    ev->name = name;
+    ev->tid = jl_trace_tid();
+    atomic_store_explicit(&ev->seq, i + 1, memory_order_release);
+}
+
+
+/* Common implementation of the *-trace-attach cfuns. Each module keeps its
+   own ring pointer, along with the Janet value that keeps it rooted. */
+static inline void jl_trace_attach(jl_trace_ring_t **ring, Janet *ring_value,
+                                   int32_t argc, Janet *argv)
+{
+    janet_fixarity(argc, 1);
+
+    if (*ring) {
+        janet_gcunroot(*ring_value);
+        *ring = NULL;
+    }
+    if (!janet_checktype(argv[0], JANET_NIL)) {
+        *ring = janet_getabstract(argv, 0, jl_get_abstract_type_by_name(UTIL_MOD_NAME "/trace-ring"));
+        *ring_value = argv[0];
+        janet_gcroot(*ring_value);
+    }
+}
+
+
+#endif
@@ -1,3 +1,5 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <errno.h>
 
@@ -11,6 +13,7 @@
 
 #include "jl.h"
 #include "types.h"
+#include "trace.h"
 
 
 #ifndef MOD_NAME
@@ -134,7 +137,7 @@ static const jl_key_def_t clock_id_defs[] = {
 
 static const JanetAbstractType jutil_at_timespec = {
     .name = MOD_NAME "/timespec",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -155,6 +158,230 @@ static Janet cfun_clock_gettime(int32_t argc, Janet *argv)
 }
 
 
+static int method_trace_ring_gc(void *p, size_t len)
+{
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    jl_trace_ring_t *ring = (jl_trace_ring_t *)p;
+    free(ring->events);
+    ring->events = NULL;
+    return 0;
+}
+
+static const JanetAbstractType jutil_at_trace_ring = {
+    .name = MOD_NAME "/trace-ring",
+    .gc = method_trace_ring_gc,
+    .gcmark = NULL,
+    JANET_ATEND_GCMARK
+};
+
+static Janet cfun_trace_ring_create(int32_t argc, Janet *argv)
+{
+    int32_t capacity;
+    uint64_t size = 1;
+
+    jl_trace_ring_t *ring;
+
+    janet_arity(argc, 0, 1);
+
+    capacity = janet_optnat(argv, argc, 0, 65536);
+    while (size < (uint64_t)capacity) {
+        size <<= 1;
+    }
+
+    ring = janet_abstract(&jutil_at_trace_ring, sizeof(*ring));
+    atomic_init(&ring->head, 0);
+    ring->mask = size - 1;
+    ring->events = calloc(size, sizeof(*(ring->events)));
+    if (!(ring->events)) {
+        JANET_OUT_OF_MEMORY;
+    }
+    return janet_wrap_abstract(ring);
+}
+
+static Janet cfun_trace_ring_clear(int32_t argc, Janet *argv)
+{
+    jl_trace_ring_t *ring;
+
+    janet_fixarity(argc, 1);
+
+    ring = janet_getabstract(argv, 0, &jutil_at_trace_ring);
+    for (uint64_t i = 0; i <= ring->mask; i++) {
+        atomic_store_explicit(&ring->events[i].seq, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ring->head, 0, memory_order_release);
+    return janet_wrap_nil();
+}
+
+static void jutil_json_escape(JanetBuffer *buf, const char *str)
+{
+    for (const char *c = str; *c; c++) {
+        if ('"' == *c || '\\' == *c) {
+            janet_buffer_push_u8(buf, '\\');
+            janet_buffer_push_u8(buf, (uint8_t)*c);
+        } else if ((uint8_t)*c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", (uint8_t)*c);
+            janet_buffer_push_cstring(buf, esc);
+        } else {
+            janet_buffer_push_u8(buf, (uint8_t)*c);
+        }
+    }
+}
+
+/* Formats the events in the Chrome trace event format, which can be loaded
+   in chrome://tracing or Perfetto */
+static Janet cfun_trace_ring_dump(int32_t argc, Janet *argv)
+{
+    jl_trace_ring_t *ring;
+    const char *path = NULL;
+
+    JanetBuffer *buf;
+    uint64_t head, first;
+    int32_t count = 0;
+    int pid = getpid();
+
+    janet_arity(argc, 1, 2);
+
+    ring = janet_getabstract(argv, 0, &jutil_at_trace_ring);
+    if (argc > 1 && !janet_checktype(argv[1], JANET_NIL)) {
+        path = janet_getcstring(argv, 1);
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    first = head > ring->mask + 1 ? head - (ring->mask + 1) : 0;
+
+    buf = janet_buffer(4096);
+    janet_buffer_push_cstring(buf, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (uint64_t i = first; i < head; i++) {
+        jl_trace_event_t *slot = &ring->events[i & ring->mask];
+        jl_trace_event_t ev;
+        char num[96];
+
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != i + 1) {
+            continue;
+        }
+        ev.ts_ns = slot->ts_ns;
+        ev.dur_ns = slot->dur_ns;
+        ev.cat = slot->cat;
+        ev.name = slot->name;
+        ev.tid = slot->tid;
+        /* Keeps the copies above from being done after the check below */
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != i + 1) {
+            /* Overwritten while copying */
+            continue;
+        }
+
+        if (count > 0) {
+            janet_buffer_push_u8(buf, ',');
+        }
+        janet_buffer_push_cstring(buf, "\n{\"name\":\"");
+        jutil_json_escape(buf, ev.name);
+        janet_buffer_push_cstring(buf, "\",\"cat\":\"");
+        jutil_json_escape(buf, ev.cat);
+        snprintf(num, sizeof(num), "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                 ev.ts_ns / 1000.0, ev.dur_ns / 1000.0, pid, ev.tid);
+        janet_buffer_push_cstring(buf, num);
+        count++;
+    }
+    janet_buffer_push_cstring(buf, "\n]}\n");
+
+    if (!path) {
+        return janet_wrap_buffer(buf);
+    }
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        janet_panicf("failed to open %s: %d", path, errno);
+    }
+    size_t written = fwrite(buf->data, 1, buf->count, f);
+    fclose(f);
+    if (written != (size_t)buf->count) {
+        janet_panicf("failed to write %s", path);
+    }
+    return janet_wrap_integer(count);
+}
+
+
+/* Modules built with JL_STATS register a MOD_NAME "/stats-source" abstract
+   type, see stats.h */
+static const char *jutil_stats_modules[] = {
+    WL_MOD_NAME,
+    WLR_MOD_NAME,
+    XKB_MOD_NAME,
+    XCB_MOD_NAME,
+    UTIL_MOD_NAME,
+    IPC_MOD_NAME,
+    NULL,
+};
+
+
+/* Calls the stats source of every loaded module with argv */
+static int jutil_stats_call_sources(int32_t argc, Janet *argv)
+{
+    int found = 0;
+
+    for (int i = 0; jutil_stats_modules[i]; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s/stats-source", jutil_stats_modules[i]);
+        const JanetAbstractType *at = janet_get_abstract_type(janet_csymbolv(name));
+        if (at && at->call) {
+            /* The parentheses keep JL_STATS from counting the sources themselves */
+            void *source = (janet_abstract)(at, 0);
+            at->call(source, argc, argv);
+            found = 1;
+        }
+    }
+    return found;
+}
+
+
+static Janet cfun_stats(int32_t argc, Janet *argv)
+{
+    (void)argv;
+    JanetTable *types;
+    JanetTable *cfuns;
+    JanetTable *stats;
+
+    janet_fixarity(argc, 0);
+
+    types = janet_table(0);
+    cfuns = janet_table(0);
+    Janet call_argv[] = {janet_wrap_table(types), janet_wrap_table(cfuns)};
+    if (!jutil_stats_call_sources(2, call_argv)) {
+        return janet_wrap_nil();
+    }
+
+    for (int32_t i = 0; i < types->capacity; i++) {
+        JanetKV *kv = &types->data[i];
+        if (janet_checktype(kv->key, JANET_NIL)) {
+            continue;
+        }
+        JanetTable *t = janet_unwrap_table(kv->value);
+        double created = janet_unwrap_number(janet_table_get(t, janet_ckeywordv("created")));
+        double collected = janet_unwrap_number(janet_table_get(t, janet_ckeywordv("collected")));
+        janet_table_put(t, janet_ckeywordv("live"), janet_wrap_number(created - collected));
+    }
+
+    stats = janet_table(2);
+    janet_table_put(stats, janet_ckeywordv("types"), janet_wrap_table(types));
+    janet_table_put(stats, janet_ckeywordv("cfuns"), janet_wrap_table(cfuns));
+    return janet_wrap_table(stats);
+}
+
+
+static Janet cfun_stats_reset(int32_t argc, Janet *argv)
+{
+    (void)argv;
+
+    janet_fixarity(argc, 0);
+
+    jutil_stats_call_sources(0, NULL);
+    return janet_wrap_nil();
+}
+
+
 static JanetReg cfuns[] = {
     {
         "get-listener-data", cfun_get_listener_data,
@@ -186,14 +413,48 @@ static JanetReg cfuns[] = {
         "(" MOD_NAME "/clock-gettime clock-id)\n\n"
         "Calls the clock_gettime C function."
     },
+    {
+        "trace-ring-create", cfun_trace_ring_create,
+        "(" MOD_NAME "/trace-ring-create &opt capacity)\n\n"
+        "Creates a ring buffer for trace events, holding the latest capacity "
+        "(rounded up to a power of two, default 65536) events. Pass it to "
+        "wl-trace-attach and wlr-trace-attach to start tracing."
+    },
+    {
+        "trace-ring-clear", cfun_trace_ring_clear,
+        "(" MOD_NAME "/trace-ring-clear trace-ring)\n\n"
+        "Drops all events in a trace ring."
+    },
+    {
+        "trace-ring-dump", cfun_trace_ring_dump,
+        "(" MOD_NAME "/trace-ring-dump trace-ring &opt path)\n\n"
+        "Dumps the events in a trace ring as Chrome trace event JSON. Writes to "
+        "path and returns the number of events if path is given, otherwise "
+        "returns a buffer."
+    },
+    {
+        "stats", cfun_stats,
+        "(" MOD_NAME "/stats)\n\n"
+        "Returns the abstract object and cfun call counters of the current "
+        "thread, in the form of {:types {type-name {:created :collected :live "
+        ":bytes}} :cfuns {cfun-name calls}}, counted since the last stats-reset. "
+        "Returns nil if no module was built with JL_STATS."
+    },
+    {
+        "stats-reset", cfun_stats_reset,
+        "(" MOD_NAME "/stats-reset)\n\n"
+        "Resets the counters returned by stats."
+    },
+    {NULL, NULL, NULL},
 };
 
 
 JANET_MODULE_ENTRY(JanetTable *env)
 {
     janet_register_abstract_type(&jutil_at_timespec);
+    janet_register_abstract_type(&jutil_at_trace_ring);
 
-    janet_cfuns(env, MOD_NAME, cfuns);
+    jl_cfuns(env, MOD_NAME, cfuns);
 
     janet_def(env, "NULL", janet_wrap_pointer(NULL), "Value for comparing pointers.");
 }
@@ -1,4 +1,11 @@
+#include <stdio.h>
 #include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include <janet.h>
 
@@ -7,6 +14,7 @@
 
 #include "jl.h"
 #include "types.h"
+#include "trace.h"
 #include "wl_abs_types.h"
 
 
@@ -15,19 +23,363 @@
 #endif
 
 
+/* Call statistics for Janet callbacks, aggregated by name. Entries are
+   never freed, since listeners and event sources keep pointers to them. */
+typedef struct jwl_profile_entry_t {
+    struct jwl_profile_entry_t *next;
+    uint8_t *name;
+    int32_t name_len;
+    uint64_t count;
+    uint64_t errors;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} jwl_profile_entry_t;
+
+JANET_THREAD_LOCAL jwl_profile_entry_t *jwl_profile_entries = NULL;
+JANET_THREAD_LOCAL int jwl_profile_enabled = 0;
+
+/* Set by wl-trace-attach, NULL when tracing is off. The Janet value is
+   kept for rooting the ring while it's attached. */
+JANET_THREAD_LOCAL jl_trace_ring_t *jwl_trace_ring = NULL;
+JANET_THREAD_LOCAL Janet jwl_trace_ring_value;
+
+/* Stall watchdog. Callbacks running past the budget get logged when they
+   return. In the :stack and :abort modes, a helper thread also interrupts
+   the Janet VM while the callback is still running, so that the stack of
+   the stalled fiber can be logged, before the callback is resumed or
+   aborted. Only the thread which enabled the watchdog is watched, and
+   only that thread logs through wlr_log. The helper thread writes its
+   in-flight notices straight to stderr. */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    int thread_running;
+    int mode;
+    uint64_t budget_ns;
+    JanetVM *vm;
+    /* Start time of the outermost running callback, 0 when idle */
+    uint64_t start_ns;
+    const char *name;
+    /* Bumped for every callback, so that each gets flagged only once */
+    uint64_t seq;
+    uint64_t flagged_seq;
+    int interrupt_pending;
+} jwl_watchdog_t;
+
+static jwl_watchdog_t jwl_watchdog = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+JANET_THREAD_LOCAL int jwl_watchdog_depth = 0;
+JANET_THREAD_LOCAL int jwl_watchdog_reported = 0;
+
+
 typedef struct {
     struct wl_event_source *event_source;
     JanetStream *stream;
     JanetFunction *cb_fn;
+    /* Pass the fd event mask to cb_fn as a plain integer, instead of
+       allocating an array of keywords for every event */
+    int raw_mask;
+    jwl_profile_entry_t *profile;
 } jwl_event_source_t;
 
 
+static jwl_profile_entry_t *jwl_profile_find_entry(const uint8_t *name, int32_t name_len)
+{
+    jwl_profile_entry_t *entry;
+
+    for (entry = jwl_profile_entries; entry; entry = entry->next) {
+        if (entry->name_len == name_len && !memcmp(entry->name, name, name_len)) {
+            return entry;
+        }
+    }
+
+    entry = janet_malloc(sizeof(*entry));
+    if (!entry) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memset(entry, 0, sizeof(*entry));
+    /* NUL-terminated, so that it can be used as a trace event name */
+    entry->name = janet_malloc(name_len + 1);
+    if (!(entry->name)) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(entry->name, name, name_len);
+    entry->name[name_len] = 0;
+    entry->name_len = name_len;
+    entry->next = jwl_profile_entries;
+    jwl_profile_entries = entry;
+    return entry;
+}
+
+
+static jwl_profile_entry_t *jwl_profile_find_entry_by_cstr(const char *name)
+{
+    return jwl_profile_find_entry((const uint8_t *)name, (int32_t)strlen(name));
+}
+
+
+static jwl_profile_entry_t *jwl_get_profile_entry(const Janet *argv, int32_t n)
+{
+    JanetByteView name = janet_getbytes(argv, n);
+    return jwl_profile_find_entry(name.bytes, name.len);
+}
+
+
+static void jwl_profile_add(jwl_profile_entry_t *profile, uint64_t ns, int failed)
+{
+    profile->count++;
+    profile->total_ns += ns;
+    if (ns > profile->max_ns) {
+        profile->max_ns = ns;
+    }
+    if (failed) {
+        profile->errors++;
+    }
+}
+
+
+static void *jwl_watchdog_thread_main(void *arg)
+{
+    (void)arg;
+    uint64_t interval_ns = jwl_watchdog.budget_ns / 4;
+    struct timespec interval;
+
+    if (interval_ns < 1000000) {
+        interval_ns = 1000000;
+    }
+    interval.tv_sec = interval_ns / 1000000000;
+    interval.tv_nsec = interval_ns % 1000000000;
+
+    for (;;) {
+        nanosleep(&interval, NULL);
+
+        pthread_mutex_lock(&jwl_watchdog.lock);
+        if (!jwl_watchdog.thread_running) {
+            pthread_mutex_unlock(&jwl_watchdog.lock);
+            break;
+        }
+        if (jwl_watchdog.start_ns && jwl_watchdog.flagged_seq != jwl_watchdog.seq) {
+            uint64_t elapsed_ns = jl_trace_now() - jwl_watchdog.start_ns;
+            if (elapsed_ns > jwl_watchdog.budget_ns) {
+                jwl_watchdog.flagged_seq = jwl_watchdog.seq;
+                jwl_watchdog.interrupt_pending = 1;
+                janet_interpreter_interrupt(jwl_watchdog.vm);
+                /* The interrupt only takes effect when the VM gets to run
+                   bytecode, and the callback may be stuck in C code, so say
+                   something right away. Not through wlr_log, since the log
+                   callback only exists on the watched thread, which logs
+                   the stall itself once it gets to handle it. */
+                fprintf(stderr, "watchdog: %s has been running for %.3f ms\n",
+                        jwl_watchdog.name, elapsed_ns / 1e6);
+            }
+        }
+        pthread_mutex_unlock(&jwl_watchdog.lock);
+    }
+
+    return NULL;
+}
+
+
+static void jwl_watchdog_stop(void)
+{
+    pthread_mutex_lock(&jwl_watchdog.lock);
+    int thread_running = jwl_watchdog.thread_running;
+    jwl_watchdog.thread_running = 0;
+    pthread_mutex_unlock(&jwl_watchdog.lock);
+
+    if (thread_running) {
+        pthread_join(jwl_watchdog.thread, NULL);
+    }
+
+    pthread_mutex_lock(&jwl_watchdog.lock);
+    if (jwl_watchdog.interrupt_pending) {
+        janet_interpreter_interrupt_handled(jwl_watchdog.vm);
+        jwl_watchdog.interrupt_pending = 0;
+    }
+    jwl_watchdog.budget_ns = 0;
+    jwl_watchdog.start_ns = 0;
+    jwl_watchdog.vm = NULL;
+    pthread_mutex_unlock(&jwl_watchdog.lock);
+}
+
+
+static void jwl_watchdog_report(const char *name, uint64_t elapsed_ns, JanetFiber *fiber)
+{
+    if (fiber) {
+        /* Capture the stack trace, so that it goes through the log callback
+           instead of straight to stderr */
+        JanetBuffer *buf = janet_buffer(0);
+        Janet err = janet_dyn("err");
+        janet_setdyn("err", janet_wrap_buffer(buf));
+        janet_stacktrace_ext(fiber, janet_cstringv("callback stalled"), "watchdog");
+        janet_setdyn("err", err);
+        janet_buffer_push_u8(buf, 0);
+        wlr_log(WLR_ERROR, "watchdog: %s has been running for %.3f ms\n%s",
+                name, elapsed_ns / 1e6, (const char *)buf->data);
+    } else {
+        wlr_log(WLR_ERROR, "watchdog: %s exceeded its budget, took %.3f ms",
+                name, elapsed_ns / 1e6);
+    }
+}
+
+
+/* Returns 0 if the call is not watched, 1 for nested calls, and 2 for the
+   outermost call, which is the one being timed */
+static int jwl_watchdog_begin(const char *name)
+{
+    int watched = 0;
+
+    if (!jwl_watchdog.budget_ns || jwl_watchdog.vm != janet_local_vm()) {
+        return 0;
+    }
+
+    if (jwl_watchdog_depth++ > 0) {
+        return 1;
+    }
+
+    pthread_mutex_lock(&jwl_watchdog.lock);
+    if (jwl_watchdog.budget_ns) {
+        jwl_watchdog.seq++;
+        jwl_watchdog.name = name;
+        jwl_watchdog.start_ns = jl_trace_now();
+        jwl_watchdog_reported = 0;
+        watched = 2;
+    }
+    pthread_mutex_unlock(&jwl_watchdog.lock);
+
+    if (!watched) {
+        jwl_watchdog_depth--;
+    }
+    return watched;
+}
+
+
+/* Checks whether a JANET_SIGNAL_INTERRUPT came from the watchdog, and
+   acknowledges it if so */
+static int jwl_watchdog_take_interrupt(const char *name, JanetFiber *fiber)
+{
+    uint64_t start_ns;
+
+    pthread_mutex_lock(&jwl_watchdog.lock);
+    int pending = jwl_watchdog.interrupt_pending;
+    if (pending) {
+        janet_interpreter_interrupt_handled(jwl_watchdog.vm);
+        jwl_watchdog.interrupt_pending = 0;
+    }
+    start_ns = jwl_watchdog.start_ns;
+    pthread_mutex_unlock(&jwl_watchdog.lock);
+
+    if (pending) {
+        jwl_watchdog_report(name, start_ns ? jl_trace_now() - start_ns : 0, fiber);
+        jwl_watchdog_reported = 1;
+    }
+    return pending;
+}
+
+
+static void jwl_watchdog_end(int watched)
+{
+    uint64_t start_ns;
+    const char *name;
+
+    if (!watched) {
+        return;
+    }
+    jwl_watchdog_depth--;
+    if (watched < 2) {
+        return;
+    }
+
+    pthread_mutex_lock(&jwl_watchdog.lock);
+    start_ns = jwl_watchdog.start_ns;
+    name = jwl_watchdog.name;
+    jwl_watchdog.start_ns = 0;
+    if (jwl_watchdog.interrupt_pending) {
+        /* The callback returned before the VM noticed the interrupt, don't
+           let it hit whatever Janet code runs next */
+        janet_interpreter_interrupt_handled(jwl_watchdog.vm);
+        jwl_watchdog.interrupt_pending = 0;
+    }
+    uint64_t budget_ns = jwl_watchdog.budget_ns;
+    pthread_mutex_unlock(&jwl_watchdog.lock);
+
+    if (start_ns && !jwl_watchdog_reported) {
+        uint64_t elapsed_ns = jl_trace_now() - start_ns;
+        if (elapsed_ns > budget_ns) {
+            jwl_watchdog_report(name, elapsed_ns, NULL);
+        }
+    }
+}
+
+
+/* Common trampoline for calling Janet callbacks from the Wayland event loop.
+   Errors are reported here, timing is recorded in profile when profiling
+   is enabled, and in the trace ring when tracing is on. Stalls are
+   reported by the watchdog, if any. */
+static int jwl_pcall(JanetFunction *fn, int32_t argc, const Janet *argv, Janet *ret,
+                     jwl_profile_entry_t *profile)
+{
+    JanetFiber *fiber = NULL;
+    uint64_t start_ns = 0;
+    int profiling = jwl_profile_enabled && profile;
+    jl_trace_ring_t *trace_ring = profile ? jwl_trace_ring : NULL;
+
+    if (profiling || trace_ring) {
+        start_ns = jl_trace_now();
+    }
+
+    /* XXX: janet_pcall() without janet_gclock() here causes memory violation,
+       don't know why */
+    const char *name = profile ? (const char *)profile->name : "callback";
+    int watched = jwl_watchdog_begin(name);
+
+    int locked = janet_gclock();
+    int sig = janet_pcall(fn, argc, argv, ret, &fiber);
+    while (watched && JANET_SIGNAL_INTERRUPT == sig && jwl_watchdog_take_interrupt(name, fiber)) {
+        if (JWL_WATCHDOG_ABORT == jwl_watchdog.mode) {
+            *ret = janet_cstringv("interrupted by watchdog");
+            break;
+        }
+        sig = janet_continue(fiber, janet_wrap_nil(), ret);
+    }
+    janet_gcunlock(locked);
+
+    jwl_watchdog_end(watched);
+
+    if (profiling || trace_ring) {
+        uint64_t end_ns = jl_trace_now();
+        uint64_t ns = end_ns - start_ns;
+        if (trace_ring) {
+            jl_trace_record(trace_ring, "callback", (const char *)profile->name, start_ns, end_ns);
+        }
+        if (profiling) {
+            jwl_profile_add(profile, ns, JANET_SIGNAL_OK != sig);
+        }
+    }
+
+    if (JANET_SIGNAL_OK != sig) {
+        janet_stacktrace(fiber, *ret);
+    }
+    return sig;
+}
+
+
+static uint32_t jwl_get_event_mask(const Janet *argv, int32_t n)
+{
+    if (janet_checkint(argv[n])) {
+        return (uint32_t)janet_getinteger(argv, n);
+    }
+    return jl_get_key_flags(argv, n, wl_event_defs);
+}
+
+
 int jwl_event_loop_fd_callback(int fd, uint32_t mask, void *data)
 {
     jwl_event_source_t *source = data;
     Janet argv[2];
     Janet ret = janet_wrap_nil();
-    JanetFiber *fiber = NULL;
 
     if (source->stream) {
         argv[0] = janet_wrap_abstract(source->stream);
@@ -35,14 +387,15 @@ int jwl_event_loop_fd_callback(int fd, uint32_t mask, void *data)
         argv[0] = janet_wrap_integer(fd);
     }
 
-    argv[1] = janet_wrap_array(jl_get_flag_keys(mask, wl_event_defs));
+    if (source->raw_mask) {
+        argv[1] = janet_wrap_integer(mask);
+    } else {
+        argv[1] = janet_wrap_array(jl_get_flag_keys(mask, wl_event_defs));
+    }
 
-    int locked = janet_gclock();
-    int sig = janet_pcall(source->cb_fn, 2, argv, &ret, &fiber);
-    janet_gcunlock(locked);
+    int sig = jwl_pcall(source->cb_fn, 2, argv, &ret, source->profile);
 
     if (JANET_SIGNAL_OK != sig) {
-        janet_stacktrace(fiber, ret);
         return 0;
     } else {
         if (janet_checkint(ret)) {
@@ -59,14 +412,10 @@ int jwl_event_loop_timer_callback(void *data)
 {
     jwl_event_source_t *source = data;
     Janet ret = janet_wrap_nil();
-    JanetFiber *fiber = NULL;
 
-    int locked = janet_gclock();
-    int sig = janet_pcall(source->cb_fn, 0, NULL, &ret, &fiber);
-    janet_gcunlock(locked);
+    int sig = jwl_pcall(source->cb_fn, 0, NULL, &ret, source->profile);
 
     if (JANET_SIGNAL_OK != sig) {
-        janet_stacktrace(fiber, ret);
         return 0;
     } else {
         if (janet_checkint(ret)) {
@@ -83,7 +432,6 @@ int jwl_event_loop_signal_callback(int signal_number, void *data)
 {
     jwl_event_source_t *source = data;
     Janet ret = janet_wrap_nil();
-    JanetFiber *fiber = NULL;
     Janet argv[1];
     const char *signal_name = NULL;
 
@@ -100,12 +448,9 @@ int jwl_event_loop_signal_callback(int signal_number, void *data)
         argv[0] = janet_wrap_integer(signal_number);
     }
 
-    int locked = janet_gclock();
-    int sig = janet_pcall(source->cb_fn, 1, argv, &ret, &fiber);
-    janet_gcunlock(locked);
+    int sig = jwl_pcall(source->cb_fn, 1, argv, &ret, source->profile);
 
     if (JANET_SIGNAL_OK != sig) {
-        janet_stacktrace(fiber, ret);
         return 0;
     } else {
         if (janet_checkint(ret)) {
@@ -122,42 +467,149 @@ void jwl_event_loop_idle_callback(void *data)
 {
     jwl_event_source_t *source = data;
     Janet ret = janet_wrap_nil();
-    JanetFiber *fiber = NULL;
-
-    int locked = janet_gclock();
-    int sig = janet_pcall(source->cb_fn, 0, NULL, &ret, &fiber);
-    janet_gcunlock(locked);
 
-    if (JANET_SIGNAL_OK != sig) {
-        janet_stacktrace(fiber, ret);
-    }
+    jwl_pcall(source->cb_fn, 0, NULL, &ret, source->profile);
 }
 
 
 typedef struct {
     struct wl_listener wl_listener;
     JanetFunction *notify_fn;
+    int mode;
+    /* Only used by async listeners. snapshot_spec is a tuple in the form of
+       [abstract-type-name & keys], snapshot_at is the resolved abstract type. */
+    const Janet *snapshot_spec;
+    const JanetAbstractType *snapshot_at;
+    jwl_profile_entry_t *profile;
 } jwl_listener_t;
 
 
+/* The event struct passed to a listener usually lives on the stack of the
+   emitter, so async listeners can not keep the raw pointer around. We read
+   the requested fields through the abstract type's getter while the event
+   is still alive, and hand a plain struct to the listener fiber instead. */
+static Janet jwl_listener_snapshot(jwl_listener_t *listener, void *data)
+{
+    if (!data || !(listener->snapshot_spec)) {
+        /* The raw pointer would be dangling by the time the listener runs */
+        return janet_wrap_nil();
+    }
+
+    const JanetAbstractType *at = listener->snapshot_at;
+    int32_t len = janet_tuple_length(listener->snapshot_spec);
+    void **obj_p = jl_pointer_to_abs_obj(data, at);
+    JanetKV *snapshot = janet_struct_begin(len - 1);
+
+    for (int32_t i = 1; i < len; i++) {
+        Janet key = listener->snapshot_spec[i];
+        Janet value = janet_wrap_nil();
+        if (at->get(obj_p, key, &value)) {
+            janet_struct_put(snapshot, key, value);
+        }
+    }
+
+    return janet_wrap_struct(janet_struct_end(snapshot));
+}
+
+
+/* Async listeners run later in their own fiber, so when profiling, the
+   fiber runs notify_fn through this wrapper, which reports back how long
+   it took. Compiled when the module gets loaded. */
+static const char jwl_async_profile_wrapper_src[] =
+    "(fn async-profile-wrapper [now add notify-fn listener data]\n"
+    "  (def start (now))\n"
+    "  (try\n"
+    "    (do (notify-fn listener data) (add listener start false))\n"
+    "    ([err fib] (add listener start true) (propagate err fib))))";
+
+JANET_THREAD_LOCAL JanetFunction *jwl_async_profile_wrapper = NULL;
+
+
+static Janet jwl_async_profile_now(int32_t argc, Janet *argv)
+{
+    (void)argv;
+    struct timespec now;
+
+    janet_fixarity(argc, 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return janet_wrap_number(now.tv_sec + now.tv_nsec / 1e9);
+}
+
+
+static Janet jwl_async_profile_add(int32_t argc, Janet *argv)
+{
+    jwl_listener_t *listener;
+    double start;
+    Janet now;
+
+    janet_fixarity(argc, 3);
+
+    listener = janet_getabstract(argv, 0, &jwl_at_listener);
+    start = janet_getnumber(argv, 1);
+    now = jwl_async_profile_now(0, NULL);
+    if (listener->profile) {
+        double ns = (janet_unwrap_number(now) - start) * 1e9;
+        jwl_profile_add(listener->profile, ns > 0 ? (uint64_t)ns : 0, janet_truthy(argv[2]));
+    }
+    return janet_wrap_nil();
+}
+
+
+static void jwl_listener_notify_async(jwl_listener_t *listener, void *data)
+{
+    JanetTryState tstate;
+    JanetSignal sig = janet_try(&tstate);
+
+    if (JANET_SIGNAL_OK == sig) {
+        JanetFiber *fiber;
+        if (jwl_profile_enabled && listener->profile && jwl_async_profile_wrapper) {
+            Janet argv[] = {
+                janet_wrap_cfunction(jwl_async_profile_now),
+                janet_wrap_cfunction(jwl_async_profile_add),
+                janet_wrap_function(listener->notify_fn),
+                janet_wrap_abstract(listener),
+                jwl_listener_snapshot(listener, data),
+            };
+            fiber = janet_fiber(jwl_async_profile_wrapper, 64, 5, argv);
+        } else {
+            Janet argv[] = {
+                janet_wrap_abstract(listener),
+                jwl_listener_snapshot(listener, data),
+            };
+            fiber = janet_fiber(listener->notify_fn, 64, 2, argv);
+        }
+        if (!fiber) {
+            janet_panic("failed to create fiber for async listener");
+        }
+        janet_schedule(fiber, janet_wrap_nil());
+        janet_restore(&tstate);
+    } else {
+        janet_restore(&tstate);
+        janet_eprintf("failed to schedule async listener: %v\n", tstate.payload);
+    }
+}
+
+
 void jwl_listener_notify_callback(struct wl_listener *wl_listener, void *data)
 {
     jwl_listener_t *listener = wl_container_of(wl_listener, listener, wl_listener);
-    JanetFunction *notify_fn = listener->notify_fn;
+
+    if (JWL_LISTENER_ASYNC == listener->mode) {
+        /* Timed by jwl_async_profile_wrapper, when the fiber actually runs */
+        int locked = janet_gclock();
+        jwl_listener_notify_async(listener, data);
+        janet_gcunlock(locked);
+        return;
+    }
+
     Janet argv[] = {
         janet_wrap_abstract(listener),
         janet_wrap_pointer(data),
     };
     Janet ret = janet_wrap_nil();
-    JanetFiber *fiber = NULL;
-    /* XXX: janet_pcall() without janet_gclock() here causes memory violation,
-       don't know why */
-    int locked = janet_gclock();
-    int sig = janet_pcall(notify_fn, 2, argv, &ret, &fiber);
-    janet_gcunlock(locked);
-    if (JANET_SIGNAL_OK != sig) {
-        janet_stacktrace(fiber, ret);
-    }
+
+    jwl_pcall(listener->notify_fn, 2, argv, &ret, listener->profile);
 }
 
 
@@ -185,11 +637,32 @@ static int method_listener_gcmark(void *p, size_t len)
     if (listener->notify_fn) {
         janet_mark(janet_wrap_function(listener->notify_fn));
     }
+    if (listener->snapshot_spec) {
+        janet_mark(janet_wrap_tuple(listener->snapshot_spec));
+    }
 
     return 0;
 }
 
 
+static int jwl_event_loop_dispatch_traced(struct wl_event_loop *event_loop, int timeout)
+{
+    jl_trace_ring_t *trace_ring = jwl_trace_ring;
+    uint64_t start_ns;
+    int ret;
+
+    if (!trace_ring) {
+        return wl_event_loop_dispatch(event_loop, timeout);
+    }
+
+    start_ns = jl_trace_now();
+    ret = wl_event_loop_dispatch(event_loop, timeout);
+    /* Includes the time spent waiting, when timeout is not 0 */
+    jl_trace_record(trace_ring, "loop", "dispatch", start_ns, jl_trace_now());
+    return ret;
+}
+
+
 static Janet cfun_wl_event_loop_create(int32_t argc, Janet *argv)
 {
     (void)argv;
@@ -227,7 +700,7 @@ static Janet cfun_wl_event_loop_dispatch(int32_t argc, Janet *argv)
 
     event_loop = jl_get_abs_obj_pointer(argv, 0, &jwl_at_wl_event_loop);
     timeout = janet_getinteger(argv, 1);
-    return janet_wrap_integer(wl_event_loop_dispatch(event_loop, timeout));
+    return janet_wrap_integer(jwl_event_loop_dispatch_traced(event_loop, timeout));
 }
 
 
@@ -252,7 +725,7 @@ static Janet cfun_wl_event_loop_add_fd(int32_t argc, Janet *argv)
 
     jwl_event_source_t *source;
 
-    janet_fixarity(argc, 4);
+    janet_arity(argc, 4, 5);
 
     source = janet_abstract(&jwl_at_event_source, sizeof(*source));
     memset(source, 0, sizeof(*source));
@@ -266,14 +739,18 @@ static Janet cfun_wl_event_loop_add_fd(int32_t argc, Janet *argv)
         /* XXX: Check whether the handle is a valid fd? */
         fd = stream->handle;
     }
-    mask = jl_get_key_flags(argv, 2, wl_event_defs);
+    mask = jwl_get_event_mask(argv, 2);
     func = janet_getfunction(argv, 3);
+    if (argc > 4) {
+        source->raw_mask = janet_truthy(argv[4]);
+    }
 
     source->event_source = wl_event_loop_add_fd(event_loop, fd, mask, jwl_event_loop_fd_callback, source);
     if (!(source->event_source)) {
         janet_panic("failed to add fd to wayland event loop");
     }
     source->cb_fn = func;
+    source->profile = jwl_profile_find_entry_by_cstr("fd");
     janet_gcroot(janet_wrap_function(func));
     if (source->stream) {
         janet_gcroot(janet_wrap_abstract(source->stream));
@@ -290,7 +767,7 @@ static Janet cfun_wl_event_source_fd_update(int32_t argc, Janet *argv)
     janet_fixarity(argc, 2);
 
     source = janet_getabstract(argv, 0, &jwl_at_event_source);
-    mask = jl_get_key_flags(argv, 1, wl_event_defs);
+    mask = jwl_get_event_mask(argv, 1);
     return janet_wrap_integer(wl_event_source_fd_update(source->event_source, mask));
 }
 
@@ -315,6 +792,7 @@ static Janet cfun_wl_event_loop_add_timer(int32_t argc, Janet *argv)
         janet_panic("failed to add timer to wayland event loop");
     }
     source->cb_fn = func;
+    source->profile = jwl_profile_find_entry_by_cstr("timer");
     janet_gcroot(janet_wrap_function(func));
     return janet_wrap_abstract(source);
 }
@@ -359,6 +837,7 @@ static Janet cfun_wl_event_loop_add_signal(int32_t argc, Janet *argv)
         janet_panic("failed to add signal handler to wayland event loop");
     }
     source->cb_fn = func;
+    source->profile = jwl_profile_find_entry_by_cstr("signal");
     janet_gcroot(janet_wrap_function(func));
     return janet_wrap_abstract(source);
 }
@@ -384,6 +863,7 @@ static Janet cfun_wl_event_loop_add_idle(int32_t argc, Janet *argv)
         janet_panic("failed to add idle source to wayland event loop");
     }
     source->cb_fn = func;
+    source->profile = jwl_profile_find_entry_by_cstr("idle");
     janet_gcroot(janet_wrap_function(func));
     return janet_wrap_abstract(source);
 }
@@ -415,7 +895,7 @@ void wl_event_loop_stream_dispatch_callback(JanetFiber *fiber, JanetAsyncEvent e
     case JANET_ASYNC_EVENT_READ:
     case JANET_ASYNC_EVENT_WRITE: {
         //wlr_log(WLR_DEBUG, "dispatching events from wayland event loop....");
-        int ret = wl_event_loop_dispatch(event_loop, 0);
+        int ret = jwl_event_loop_dispatch_traced(event_loop, 0);
         if (ret < 0) {
             wlr_log(WLR_ERROR, "wl_event_loop_dispatch() failed: %d", ret);
         }
@@ -523,8 +1003,10 @@ static Janet cfun_wl_event_loop_add_destroy_listener(int32_t argc, Janet *argv)
     notify_fn = janet_getfunction(argv, 1);
 
     listener = janet_abstract(&jwl_at_listener, sizeof(*listener));
+    memset(listener, 0, sizeof(*listener));
     listener->wl_listener.notify = jwl_listener_notify_callback;
     listener->notify_fn = notify_fn;
+    listener->mode = JWL_LISTENER_SYNC;
 
     janet_gcroot(janet_wrap_function(notify_fn));
     wl_event_loop_add_destroy_listener(event_loop, &listener->wl_listener);
@@ -567,6 +1049,228 @@ static Janet cfun_wl_event_source_remove(int32_t argc, Janet *argv)
 }
 
 
+/* A mailbox is a threaded abstract object, so it can be passed to other Janet
+   threads (e.g. as the argument of ev/thread). Any thread can post messages,
+   but they are always handled on the thread that owns the wayland event loop,
+   woken up by an eventfd. Fields below the mutex are only touched by the
+   owner thread. */
+typedef struct jwl_mailbox_msg_t {
+    struct jwl_mailbox_msg_t *next;
+    int32_t len;
+    uint8_t data[];
+} jwl_mailbox_msg_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    jwl_mailbox_msg_t *head;
+    jwl_mailbox_msg_t *tail;
+    int closed;
+    int efd;
+
+    struct wl_event_source *event_source;
+    JanetFunction *handler_fn;
+    jwl_profile_entry_t *profile;
+} jwl_mailbox_t;
+
+
+static int method_mailbox_gc(void *p, size_t len)
+{
+    (void)len;
+    /* Not counted by JL_STATS, since janet_abstract_threaded() isn't, and
+       this may run on any thread holding a reference */
+    jwl_mailbox_t *mailbox = (jwl_mailbox_t *)p;
+
+    jwl_mailbox_msg_t *msg = mailbox->head;
+    while (msg) {
+        jwl_mailbox_msg_t *next = msg->next;
+        free(msg);
+        msg = next;
+    }
+    if (mailbox->efd >= 0) {
+        close(mailbox->efd);
+    }
+    pthread_mutex_destroy(&mailbox->lock);
+
+    return 0;
+}
+
+
+static void jwl_mailbox_handle_msg(jwl_mailbox_t *mailbox, JanetFunction *handler_fn,
+                                   jwl_mailbox_msg_t *msg)
+{
+    Janet value = janet_wrap_nil();
+    JanetTryState tstate;
+    JanetSignal sig = janet_try(&tstate);
+
+    if (JANET_SIGNAL_OK == sig) {
+        value = janet_unmarshal(msg->data, msg->len, JANET_MARSHAL_UNSAFE, NULL, NULL);
+        janet_restore(&tstate);
+    } else {
+        janet_restore(&tstate);
+        janet_eprintf("failed to unmarshal mailbox message: %v\n", tstate.payload);
+        return;
+    }
+
+    Janet argv[] = {
+        value,
+    };
+    Janet ret = janet_wrap_nil();
+
+    jwl_pcall(handler_fn, 1, argv, &ret, mailbox->profile);
+}
+
+
+int jwl_mailbox_fd_callback(int fd, uint32_t mask, void *data)
+{
+    (void)mask;
+    jwl_mailbox_t *mailbox = data;
+    JanetFunction *handler_fn = mailbox->handler_fn;
+    uint64_t count;
+    jwl_mailbox_msg_t *msg;
+
+    /* Nonblocking, a failed read only means there is nothing to clear */
+    if (read(fd, &count, sizeof(count)) < 0) {
+        count = 0;
+    }
+
+    pthread_mutex_lock(&mailbox->lock);
+    msg = mailbox->head;
+    mailbox->head = NULL;
+    mailbox->tail = NULL;
+    pthread_mutex_unlock(&mailbox->lock);
+
+    if (!msg) {
+        return 0;
+    }
+
+    /* The handler may remove the mailbox, but the senders of the messages
+       already taken off the queue were told they got through (and may be
+       waiting for replies), so deliver the whole batch anyway. Keep the
+       mailbox and the handler alive until then. */
+    janet_gcroot(janet_wrap_abstract(mailbox));
+    janet_gcroot(janet_wrap_function(handler_fn));
+
+    while (msg) {
+        jwl_mailbox_msg_t *next = msg->next;
+        jwl_mailbox_handle_msg(mailbox, handler_fn, msg);
+        free(msg);
+        msg = next;
+    }
+
+    janet_gcunroot(janet_wrap_function(handler_fn));
+    janet_gcunroot(janet_wrap_abstract(mailbox));
+    return 0;
+}
+
+
+static Janet cfun_wl_event_loop_add_mailbox(int32_t argc, Janet *argv)
+{
+    struct wl_event_loop *event_loop;
+    JanetFunction *handler_fn;
+
+    jwl_mailbox_t *mailbox;
+
+    janet_fixarity(argc, 2);
+
+    event_loop = jl_get_abs_obj_pointer(argv, 0, &jwl_at_wl_event_loop);
+    handler_fn = janet_getfunction(argv, 1);
+
+    mailbox = janet_abstract_threaded(&jwl_at_mailbox, sizeof(*mailbox));
+    memset(mailbox, 0, sizeof(*mailbox));
+    pthread_mutex_init(&mailbox->lock, NULL);
+    mailbox->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mailbox->efd < 0) {
+        janet_panicf("failed to create eventfd for mailbox: %d", errno);
+    }
+
+    mailbox->event_source = wl_event_loop_add_fd(event_loop, mailbox->efd, WL_EVENT_READABLE,
+                                                 jwl_mailbox_fd_callback, mailbox);
+    if (!(mailbox->event_source)) {
+        janet_panic("failed to add mailbox to wayland event loop");
+    }
+    mailbox->handler_fn = handler_fn;
+    mailbox->profile = jwl_profile_find_entry_by_cstr("mailbox");
+
+    /* Threaded abstract objects are not traced by the GC, root everything
+       the owner thread needs while the mailbox is registered. */
+    janet_gcroot(janet_wrap_function(handler_fn));
+    janet_gcroot(janet_wrap_abstract(mailbox));
+    return janet_wrap_abstract(mailbox);
+}
+
+
+static Janet cfun_wl_mailbox_post(int32_t argc, Janet *argv)
+{
+    jwl_mailbox_t *mailbox;
+
+    JanetBuffer *buf;
+    jwl_mailbox_msg_t *msg;
+    uint64_t one = 1;
+    int closed;
+
+    janet_fixarity(argc, 2);
+
+    mailbox = janet_getabstract(argv, 0, &jwl_at_mailbox);
+
+    buf = janet_buffer(64);
+    janet_marshal(buf, argv[1], NULL, JANET_MARSHAL_UNSAFE);
+
+    msg = malloc(sizeof(*msg) + buf->count);
+    if (!msg) {
+        JANET_OUT_OF_MEMORY;
+    }
+    msg->next = NULL;
+    msg->len = buf->count;
+    memcpy(msg->data, buf->data, buf->count);
+
+    pthread_mutex_lock(&mailbox->lock);
+    closed = mailbox->closed;
+    if (!closed) {
+        if (mailbox->tail) {
+            mailbox->tail->next = msg;
+        } else {
+            mailbox->head = msg;
+        }
+        mailbox->tail = msg;
+    }
+    pthread_mutex_unlock(&mailbox->lock);
+
+    if (closed) {
+        free(msg);
+        return janet_wrap_false();
+    }
+
+    if (write(mailbox->efd, &one, sizeof(one)) < 0 && EAGAIN != errno) {
+        janet_panicf("failed to wake up mailbox: %d", errno);
+    }
+    return janet_wrap_true();
+}
+
+
+static Janet cfun_wl_mailbox_remove(int32_t argc, Janet *argv)
+{
+    jwl_mailbox_t *mailbox;
+
+    janet_fixarity(argc, 1);
+
+    mailbox = janet_getabstract(argv, 0, &jwl_at_mailbox);
+    if (!(mailbox->handler_fn)) {
+        return janet_wrap_nil();
+    }
+
+    pthread_mutex_lock(&mailbox->lock);
+    mailbox->closed = 1;
+    pthread_mutex_unlock(&mailbox->lock);
+
+    wl_event_source_remove(mailbox->event_source);
+    mailbox->event_source = NULL;
+    janet_gcunroot(janet_wrap_function(mailbox->handler_fn));
+    mailbox->handler_fn = NULL;
+    janet_gcunroot(janet_wrap_abstract(mailbox));
+    return janet_wrap_nil();
+}
+
+
 static Janet cfun_wl_list_empty(int32_t argc, Janet *argv)
 {
     struct wl_list *list;
@@ -707,19 +1411,53 @@ static Janet cfun_wl_signal_add(int32_t argc, Janet *argv)
 {
     struct wl_signal *signal;
     JanetFunction *notify_fn;
+    int mode = JWL_LISTENER_SYNC;
+    const Janet *snapshot_spec = NULL;
+    jwl_profile_entry_t *profile = NULL;
 
+    const JanetAbstractType *snapshot_at = NULL;
     jwl_listener_t *listener;
 
-    janet_fixarity(argc, 2);
+    janet_arity(argc, 2, 5);
 
     signal = jl_get_abs_obj_pointer(argv, 0, &jwl_at_wl_signal);
     notify_fn = janet_getfunction(argv, 1);
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        mode = jl_get_key_def(argv, 2, listener_mode_defs);
+    }
+    if (argc > 3 && !janet_checktype(argv[3], JANET_NIL)) {
+        if (JWL_LISTENER_ASYNC != mode) {
+            janet_panic("event snapshots are only supported by async listeners");
+        }
+        snapshot_spec = janet_gettuple(argv, 3);
+        if (janet_tuple_length(snapshot_spec) < 1 ||
+            !janet_checktype(snapshot_spec[0], JANET_SYMBOL)) {
+            janet_panicf("expected [abstract-type & keys], got %v", argv[3]);
+        }
+        snapshot_at = jl_get_abstract_type_by_key(snapshot_spec[0]);
+        if (!(snapshot_at->get)) {
+            janet_panicf("abstract type %v has no getter", snapshot_spec[0]);
+        }
+    }
+    if (argc > 4 && !janet_checktype(argv[4], JANET_NIL)) {
+        profile = jwl_get_profile_entry(argv, 4);
+    } else {
+        profile = jwl_profile_find_entry_by_cstr("listener");
+    }
 
     listener = janet_abstract(&jwl_at_listener, sizeof(*listener));
+    memset(listener, 0, sizeof(*listener));
     listener->wl_listener.notify = jwl_listener_notify_callback;
     listener->notify_fn = notify_fn;
+    listener->mode = mode;
+    listener->snapshot_spec = snapshot_spec;
+    listener->snapshot_at = snapshot_at;
+    listener->profile = profile;
 
     janet_gcroot(janet_wrap_function(notify_fn));
+    if (snapshot_spec) {
+        janet_gcroot(janet_wrap_tuple(snapshot_spec));
+    }
     wl_signal_add(signal, &listener->wl_listener);
 
     return janet_wrap_abstract(listener);
@@ -736,6 +1474,9 @@ static Janet cfun_wl_signal_remove(int32_t argc, Janet *argv)
 
     wl_list_remove(&listener->wl_listener.link);
     janet_gcunroot(janet_wrap_function(listener->notify_fn));
+    if (listener->snapshot_spec) {
+        janet_gcunroot(janet_wrap_tuple(listener->snapshot_spec));
+    }
 
     return janet_wrap_nil();
 }
@@ -760,6 +1501,134 @@ static Janet cfun_wl_signal_emit(int32_t argc, Janet *argv)
 }
 
 
+static Janet cfun_wl_profile_enable(int32_t argc, Janet *argv)
+{
+    int prev = jwl_profile_enabled;
+
+    janet_arity(argc, 0, 1);
+
+    jwl_profile_enabled = argc > 0 ? janet_truthy(argv[0]) : 1;
+    return janet_wrap_boolean(prev);
+}
+
+
+static Janet cfun_wl_profile_tag(int32_t argc, Janet *argv)
+{
+    jwl_profile_entry_t *profile;
+
+    janet_fixarity(argc, 2);
+
+    profile = jwl_get_profile_entry(argv, 1);
+    if (janet_checkabstract(argv[0], &jwl_at_listener)) {
+        jwl_listener_t *listener = janet_unwrap_abstract(argv[0]);
+        listener->profile = profile;
+    } else if (janet_checkabstract(argv[0], &jwl_at_mailbox)) {
+        jwl_mailbox_t *mailbox = janet_unwrap_abstract(argv[0]);
+        mailbox->profile = profile;
+    } else {
+        jwl_event_source_t *source = janet_getabstract(argv, 0, &jwl_at_event_source);
+        source->profile = profile;
+    }
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wl_profile_stats(int32_t argc, Janet *argv)
+{
+    (void)argv;
+    JanetTable *stats;
+
+    janet_fixarity(argc, 0);
+
+    stats = janet_table(0);
+    for (jwl_profile_entry_t *entry = jwl_profile_entries; entry; entry = entry->next) {
+        if (0 == entry->count) {
+            continue;
+        }
+        JanetKV *st = janet_struct_begin(5);
+        janet_struct_put(st, janet_ckeywordv("count"), janet_wrap_number((double)entry->count));
+        janet_struct_put(st, janet_ckeywordv("errors"), janet_wrap_number((double)entry->errors));
+        janet_struct_put(st, janet_ckeywordv("total-ms"), janet_wrap_number(entry->total_ns / 1e6));
+        janet_struct_put(st, janet_ckeywordv("max-ms"), janet_wrap_number(entry->max_ns / 1e6));
+        janet_struct_put(st, janet_ckeywordv("mean-ms"),
+                         janet_wrap_number(entry->total_ns / 1e6 / entry->count));
+        janet_table_put(stats,
+                        janet_stringv(entry->name, entry->name_len),
+                        janet_wrap_struct(janet_struct_end(st)));
+    }
+    return janet_wrap_table(stats);
+}
+
+
+static Janet cfun_wl_profile_reset(int32_t argc, Janet *argv)
+{
+    (void)argv;
+
+    janet_fixarity(argc, 0);
+
+    for (jwl_profile_entry_t *entry = jwl_profile_entries; entry; entry = entry->next) {
+        entry->count = 0;
+        entry->errors = 0;
+        entry->total_ns = 0;
+        entry->max_ns = 0;
+    }
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wl_trace_attach(int32_t argc, Janet *argv)
+{
+    jl_trace_attach(&jwl_trace_ring, &jwl_trace_ring_value, argc, argv);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wl_watchdog_enable(int32_t argc, Janet *argv)
+{
+    double budget_ms;
+    int mode;
+
+    janet_arity(argc, 1, 2);
+
+    budget_ms = janet_getnumber(argv, 0);
+    if (budget_ms <= 0) {
+        janet_panicf("invalid budget: %v", argv[0]);
+    }
+    mode = argc > 1 ? jl_get_key_def(argv, 1, watchdog_mode_defs) : JWL_WATCHDOG_PASSIVE;
+
+    jwl_watchdog_stop();
+
+    pthread_mutex_lock(&jwl_watchdog.lock);
+    jwl_watchdog.mode = mode;
+    jwl_watchdog.budget_ns = (uint64_t)(budget_ms * 1e6);
+    jwl_watchdog.vm = janet_local_vm();
+    if (JWL_WATCHDOG_PASSIVE != mode) {
+        int ret = pthread_create(&jwl_watchdog.thread, NULL, jwl_watchdog_thread_main, NULL);
+        if (ret) {
+            jwl_watchdog.budget_ns = 0;
+            jwl_watchdog.vm = NULL;
+            pthread_mutex_unlock(&jwl_watchdog.lock);
+            janet_panicf("failed to create watchdog thread: %s", strerror(ret));
+        }
+        jwl_watchdog.thread_running = 1;
+    }
+    pthread_mutex_unlock(&jwl_watchdog.lock);
+
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wl_watchdog_disable(int32_t argc, Janet *argv)
+{
+    (void)argv;
+
+    janet_fixarity(argc, 0);
+
+    jwl_watchdog_stop();
+    return janet_wrap_nil();
+}
+
+
 static JanetReg cfuns[] = {
     {
         "wl-event-loop-create", cfun_wl_event_loop_create,
@@ -783,13 +1652,17 @@ static JanetReg cfuns[] = {
     },
     {
         "wl-event-loop-add-fd", cfun_wl_event_loop_add_fd,
-        "(" MOD_NAME "/wl-event-loop-add-fd wl-event-loop fd-or-stream mask func)\n\n"
-        "Adds a file descriptor as an event source."
+        "(" MOD_NAME "/wl-event-loop-add-fd wl-event-loop fd-or-stream mask func &opt raw-mask)\n\n"
+        "Adds a file descriptor as an event source. Mask can be a keyword, "
+        "a list of keywords, or an integer built from the WL_EVENT_* constants. "
+        "When raw-mask is truthy, func receives the event mask as an integer "
+        "instead of an array of keywords."
     },
     {
         "wl-event-source-fd-update", cfun_wl_event_source_fd_update,
         "(" MOD_NAME "/wl-event-source-fd-update event-source mask)\n\n"
-        "Updates a file descriptor source's event mask."
+        "Updates a file descriptor source's event mask. Mask can be a keyword, "
+        "a list of keywords, or an integer built from the WL_EVENT_* constants."
     },
     {
         "wl-event-loop-add-timer", cfun_wl_event_loop_add_timer,
@@ -836,6 +1709,27 @@ static JanetReg cfuns[] = {
         "(" MOD_NAME "/wl-event-source-remove event-source)\n\n"
         "Removes an event source from the event loop."
     },
+    {
+        "wl-event-loop-add-mailbox", cfun_wl_event_loop_add_mailbox,
+        "(" MOD_NAME "/wl-event-loop-add-mailbox wl-event-loop handler)\n\n"
+        "Creates a mailbox that can be passed to other Janet threads. Messages "
+        "posted to it are marshalled, and (handler msg) is called for each of "
+        "them on the thread running wl-event-loop."
+    },
+    {
+        "wl-mailbox-post", cfun_wl_mailbox_post,
+        "(" MOD_NAME "/wl-mailbox-post mailbox msg)\n\n"
+        "Posts a message to a mailbox. Can be called from any thread. Returns "
+        "false if the mailbox is already removed."
+    },
+    {
+        "wl-mailbox-remove", cfun_wl_mailbox_remove,
+        "(" MOD_NAME "/wl-mailbox-remove mailbox)\n\n"
+        "Removes a mailbox from its event loop. Pending messages are dropped, "
+        "except when called from the handler, in which case the messages already "
+        "being dispatched are still delivered. Must be called on the thread "
+        "running the event loop."
+    },
     {
         "wl-list-empty", cfun_wl_list_empty,
         "(" MOD_NAME "/wl-list-empty wl-list)\n\n"
@@ -888,9 +1782,18 @@ static JanetReg cfuns[] = {
     },
     {
         "wl-signal-add", cfun_wl_signal_add,
-        "(" MOD_NAME "/wl-signal-add wl-signal notify-fn)\n\n"
+        "(" MOD_NAME "/wl-signal-add wl-signal notify-fn &opt mode snapshot name)\n\n"
         "Adds a listener to a signal. Returns a new listener object which "
-        "can be used to remove notify-fn from the signal."
+        "can be used to remove notify-fn from the signal. Mode can be :sync "
+        "(the default) or :async. Async listeners run in a new fiber on the "
+        "Janet event loop after the signal is emitted, so they can yield. "
+        "Since the event data does not outlive the emission, async listeners "
+        "receive a struct built from snapshot, in the form of "
+        "[abstract-type & keys], instead of a raw pointer, or nil when no "
+        "snapshot is given. Name is used to "
+        "aggregate call statistics, see wl-profile-stats. For async listeners, "
+        "the statistics cover the listener's fiber from start to finish, "
+        "including the time it spends suspended."
     },
     {
         "wl-signal-remove", cfun_wl_signal_remove,
@@ -902,6 +1805,56 @@ static JanetReg cfuns[] = {
         "(" MOD_NAME "/wl-signal-emit wl-signal data)\n\n"
         "Emits a signal."
     },
+    {
+        "wl-trace-attach", cfun_wl_trace_attach,
+        "(" MOD_NAME "/wl-trace-attach trace-ring)\n\n"
+        "Starts recording event loop dispatches and callback calls into a trace "
+        "ring created by util/trace-ring-create. Pass nil to stop."
+    },
+    {
+        "wl-watchdog-enable", cfun_wl_watchdog_enable,
+        "(" MOD_NAME "/wl-watchdog-enable budget-ms &opt mode)\n\n"
+        "Starts watching the Janet callbacks called from the event loop on the "
+        "current thread, and logs the ones running longer than budget-ms. "
+        "Mode can be :passive (the default), which only checks the callbacks "
+        "after they return, :stack, which also starts a helper thread to "
+        "interrupt stalled callbacks and log their stack traces before resuming "
+        "them, or :abort, which aborts them instead of resuming. The helper "
+        "thread also prints a notice to stderr as soon as it spots a stall, "
+        "since a callback stuck in C code can't be logged before it returns. "
+        "Callbacks calling into Janet functions from C code may fail when "
+        "interrupted."
+    },
+    {
+        "wl-watchdog-disable", cfun_wl_watchdog_disable,
+        "(" MOD_NAME "/wl-watchdog-disable)\n\n"
+        "Stops the watchdog."
+    },
+    {
+        "wl-profile-enable", cfun_wl_profile_enable,
+        "(" MOD_NAME "/wl-profile-enable &opt enabled)\n\n"
+        "Enables (the default) or disables timing of the Janet callbacks called "
+        "from the event loop, i.e. listeners, event sources and mailboxes. "
+        "Returns the previous state."
+    },
+    {
+        "wl-profile-tag", cfun_wl_profile_tag,
+        "(" MOD_NAME "/wl-profile-tag listener-event-source-or-mailbox name)\n\n"
+        "Sets the name under which the call statistics of a listener, event "
+        "source or mailbox are aggregated. Untagged callbacks are aggregated by kind, e.g. "
+        "\"listener\" or \"timer\"."
+    },
+    {
+        "wl-profile-stats", cfun_wl_profile_stats,
+        "(" MOD_NAME "/wl-profile-stats)\n\n"
+        "Returns a table mapping names to call statistics, in the form of "
+        "{:count :errors :total-ms :max-ms :mean-ms}."
+    },
+    {
+        "wl-profile-reset", cfun_wl_profile_reset,
+        "(" MOD_NAME "/wl-profile-reset)\n\n"
+        "Resets all call statistics."
+    },
     {NULL, NULL, NULL},
 };
 
@@ -914,6 +1867,24 @@ JANET_MODULE_ENTRY(JanetTable *env)
     janet_register_abstract_type(&jwl_at_wl_signal);
     janet_register_abstract_type(&jwl_at_listener);
     janet_register_abstract_type(&jwl_at_wl_display);
+    janet_register_abstract_type(&jwl_at_mailbox);
 
-    janet_cfuns(env, MOD_NAME, cfuns);
+    jl_cfuns(env, MOD_NAME, cfuns);
+
+    Janet wrapper;
+    if (janet_dostring(janet_core_env(NULL), jwl_async_profile_wrapper_src, MOD_NAME, &wrapper)
+        || !janet_checktype(wrapper, JANET_FUNCTION)) {
+        janet_panic("failed to compile the async listener profiling wrapper");
+    }
+    jwl_async_profile_wrapper = janet_unwrap_function(wrapper);
+    janet_gcroot(wrapper);
+
+    janet_def(env, "WL_EVENT_READABLE", janet_wrap_integer(WL_EVENT_READABLE),
+              "Integer mask for readable fd events.");
+    janet_def(env, "WL_EVENT_WRITABLE", janet_wrap_integer(WL_EVENT_WRITABLE),
+              "Integer mask for writable fd events.");
+    janet_def(env, "WL_EVENT_HANGUP", janet_wrap_integer(WL_EVENT_HANGUP),
+              "Integer mask for hangup fd events.");
+    janet_def(env, "WL_EVENT_ERROR", janet_wrap_integer(WL_EVENT_ERROR),
+              "Integer mask for error fd events.");
 }
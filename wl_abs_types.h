@@ -50,16 +50,43 @@ static const jl_key_def_t wl_event_defs[] = {
 };
 
 
+enum {
+    JWL_LISTENER_SYNC,
+    JWL_LISTENER_ASYNC,
+};
+
+static const jl_key_def_t listener_mode_defs[] = {
+    {"sync", JWL_LISTENER_SYNC},
+    {"async", JWL_LISTENER_ASYNC},
+    {NULL, 0},
+};
+
+
+enum {
+    JWL_WATCHDOG_PASSIVE,
+    JWL_WATCHDOG_STACK,
+    JWL_WATCHDOG_ABORT,
+};
+
+static const jl_key_def_t watchdog_mode_defs[] = {
+    {"passive", JWL_WATCHDOG_PASSIVE},
+    {"stack", JWL_WATCHDOG_STACK},
+    {"abort", JWL_WATCHDOG_ABORT},
+    {NULL, 0},
+};
+
+
 static const JanetAbstractType jwl_at_wl_event_loop = {
     .name = MOD_NAME "/wl-event-loop",
-    JANET_ATEND_NAME
+    .gc = JL_STATS_GC,
+    JANET_ATEND_GC
 };
 
 
 static int method_event_source_gcmark(void *p, size_t len);
 static const JanetAbstractType jwl_at_event_source = {
     .name = MOD_NAME "/event-source",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = method_event_source_gcmark,
     JANET_ATEND_GCMARK
 };
@@ -67,13 +94,14 @@ static const JanetAbstractType jwl_at_event_source = {
 
 static const JanetAbstractType jwl_at_wl_list = {
     .name = MOD_NAME "/wl-list",
-    JANET_ATEND_NAME
+    .gc = JL_STATS_GC,
+    JANET_ATEND_GC
 };
 
 
 static const JanetAbstractType jwl_at_wl_signal = {
     .name = MOD_NAME "/wl-signal",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -82,7 +110,7 @@ static const JanetAbstractType jwl_at_wl_signal = {
 static int method_listener_gcmark(void *p, size_t len);
 static const JanetAbstractType jwl_at_listener = {
     .name = MOD_NAME "/listener",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = method_listener_gcmark,
     JANET_ATEND_GCMARK
 };
@@ -90,7 +118,16 @@ static const JanetAbstractType jwl_at_listener = {
 
 static const JanetAbstractType jwl_at_wl_display = {
     .name = MOD_NAME "/wl-display",
-    .gc = NULL, /* TODO: close the display? */
+    .gc = JL_STATS_GC, /* TODO: close the display? */
+    .gcmark = NULL,
+    JANET_ATEND_GCMARK
+};
+
+
+static int method_mailbox_gc(void *p, size_t len);
+static const JanetAbstractType jwl_at_mailbox = {
+    .name = MOD_NAME "/mailbox",
+    .gc = method_mailbox_gc,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -1,15 +1,31 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <janet.h>
 
 #include <wayland-server-core.h>
 
 #include <wlr/util/log.h>
+#include <wlr/util/box.h>
+#include <wlr/util/addon.h>
 #include <wlr/backend.h>
+#include <wlr/backend/headless.h>
 #include <wlr/xwayland.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/render/allocator.h>
+#include <wlr/render/pixman.h>
+#include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_subcompositor.h>
 #include <wlr/types/wlr_data_device.h>
@@ -23,9 +39,11 @@
 #include <wlr/types/wlr_layer_shell_v1.h>
 
 #include <xkbcommon/xkbcommon.h>
+#include <drm_fourcc.h>
 
 #include "jl.h"
 #include "types.h"
+#include "trace.h"
 #include "wlr_abs_types.h"
 
 
@@ -36,6 +54,22 @@
 
 JANET_THREAD_LOCAL JanetFunction *jwlr_log_callback_fn;
 
+/* Set by wlr-trace-attach, NULL when tracing is off */
+JANET_THREAD_LOCAL jl_trace_ring_t *jwlr_trace_ring = NULL;
+JANET_THREAD_LOCAL Janet jwlr_trace_ring_value;
+
+static inline uint64_t jwlr_trace_begin(void)
+{
+    return jwlr_trace_ring ? jl_trace_now() : 0;
+}
+
+static inline void jwlr_trace_end(const char *cat, const char *name, uint64_t start_ns)
+{
+    if (jwlr_trace_ring && start_ns) {
+        jl_trace_record(jwlr_trace_ring, cat, name, start_ns, jl_trace_now());
+    }
+}
+
 static struct wl_signal **get_abstract_struct_signal_member(void *p,
                                                             const uint8_t *kw_name,
                                                             const jl_offset_def_t *offsets)
@@ -308,6 +342,31 @@ static void method_box_put(void *p, Janet key, Janet value) {
 }
 
 
+/* Boxes are plain values, so they can be sent to other threads */
+static void method_box_marshal(void *p, JanetMarshalContext *ctx)
+{
+    struct wlr_box *box = (struct wlr_box *)p;
+
+    janet_marshal_abstract(ctx, p);
+    janet_marshal_int(ctx, box->x);
+    janet_marshal_int(ctx, box->y);
+    janet_marshal_int(ctx, box->width);
+    janet_marshal_int(ctx, box->height);
+}
+
+
+static void *method_box_unmarshal(JanetMarshalContext *ctx)
+{
+    struct wlr_box *box = janet_unmarshal_abstract(ctx, sizeof(*box));
+
+    box->x = janet_unmarshal_int(ctx);
+    box->y = janet_unmarshal_int(ctx);
+    box->width = janet_unmarshal_int(ctx);
+    box->height = janet_unmarshal_int(ctx);
+    return box;
+}
+
+
 static Janet cfun_box(int32_t argc, Janet *argv)
 {
     if (argc & 0x01) {
@@ -370,6 +429,46 @@ static Janet cfun_wlr_backend_autocreate(int32_t argc, Janet *argv)
 }
 
 
+static Janet cfun_wlr_headless_backend_create(int32_t argc, Janet *argv)
+{
+    struct wl_display *display;
+
+    struct wlr_backend *backend;
+
+    janet_fixarity(argc, 1);
+
+    display = jl_get_abs_obj_pointer_by_name(argv, 0, WL_MOD_NAME "/wl-display");
+    backend = wlr_headless_backend_create(display);
+    if (!backend) {
+        janet_panic("failed to create wlroots headless backend object");
+    }
+    return janet_wrap_abstract(jl_pointer_to_abs_obj(backend, &jwlr_at_wlr_backend));
+}
+
+
+static Janet cfun_wlr_headless_add_output(int32_t argc, Janet *argv)
+{
+    struct wlr_backend *backend;
+    int32_t width, height;
+
+    struct wlr_output *output;
+
+    janet_fixarity(argc, 3);
+
+    backend = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_backend);
+    if (!wlr_backend_is_headless(backend)) {
+        janet_panicf("%v is not a headless backend", argv[0]);
+    }
+    width = janet_getnat(argv, 1);
+    height = janet_getnat(argv, 2);
+    output = wlr_headless_add_output(backend, width, height);
+    if (!output) {
+        janet_panic("failed to create headless output");
+    }
+    return janet_wrap_abstract(jl_pointer_to_abs_obj(output, &jwlr_at_wlr_output));
+}
+
+
 static Janet cfun_wlr_backend_destroy(int32_t argc, Janet *argv)
 {
     struct wlr_backend *backend;
@@ -411,6 +510,21 @@ static Janet cfun_wlr_renderer_autocreate(int32_t argc, Janet *argv)
 }
 
 
+static Janet cfun_wlr_pixman_renderer_create(int32_t argc, Janet *argv)
+{
+    (void)argv;
+    struct wlr_renderer *renderer;
+
+    janet_fixarity(argc, 0);
+
+    renderer = wlr_pixman_renderer_create();
+    if (!renderer) {
+        janet_panic("failed to create wlroots pixman renderer object");
+    }
+    return janet_wrap_abstract(jl_pointer_to_abs_obj(renderer, &jwlr_at_wlr_renderer));
+}
+
+
 static Janet cfun_wlr_renderer_init_wl_display(int32_t argc, Janet *argv)
 {
     struct wlr_renderer *renderer;
@@ -2614,595 +2728,4603 @@ static Janet cfun_wlr_scene_subsurface_tree_create(int32_t argc, Janet *argv)
 }
 
 
-static Janet cfun_wlr_scene_node_destroy(int32_t argc, Janet *argv)
-{
-    struct wlr_scene_node *node;
+/* A uniform grid over view bounding boxes, for point -> view queries that
+   don't need to walk the whole scene. Entries are attached to their scene
+   nodes through destroy listeners, which are also used to find the entries
+   again when a node gets moved (see jwlr_view_index_node_moved()). Nodes
+   with entries in their subtrees carry a count of them as an addon, so
+   that moves can skip the parts of the scene without any views. */
 
-    janet_fixarity(argc, 1);
+#define JWLR_VIEW_INDEX_BUCKET_COUNT 256
+#define JWLR_VIEW_INDEX_DEFAULT_CELL_SIZE 256
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    wlr_scene_node_destroy(node);
-    return janet_wrap_nil();
-}
+typedef struct jwlr_view_index_entry_t jwlr_view_index_entry_t;
 
+typedef struct {
+    int32_t cx;
+    int32_t cy;
+    jwlr_view_index_entry_t *entry;
+} jwlr_view_index_cell_ref_t;
 
-static Janet cfun_wlr_scene_node_set_enabled(int32_t argc, Janet *argv)
-{
+typedef struct {
+    jwlr_view_index_cell_ref_t *refs;
+    int32_t count;
+    int32_t capacity;
+} jwlr_view_index_bucket_t;
+
+typedef struct {
+    int cell_size;
+    struct wl_list entries;
+    jwlr_view_index_bucket_t buckets[JWLR_VIEW_INDEX_BUCKET_COUNT];
+} jwlr_view_index_t;
+
+/* Number of entries over all view indexes, so that moving nodes costs
+   nothing when there's nothing to update */
+JANET_THREAD_LOCAL size_t jwlr_view_index_entry_count = 0;
+
+struct jwlr_view_index_entry_t {
+    jwlr_view_index_t *index;
     struct wlr_scene_node *node;
-    bool enabled;
+    struct wl_listener destroy;
+    struct wl_list link;
+    Janet value;
+    int width;
+    int height;
+    /* The area currently registered in the grid, in layout coordinates */
+    int in_grid;
+    struct wlr_box box;
+};
 
-    janet_fixarity(argc, 2);
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    enabled = janet_getboolean(argv, 1);
-    wlr_scene_node_set_enabled(node, enabled);
-    return janet_wrap_nil();
+static inline int32_t jwlr_view_index_cell_coord(int v, int cell_size)
+{
+    /* Round towards negative infinity */
+    return v >= 0 ? v / cell_size : -((-v + cell_size - 1) / cell_size);
 }
 
+static inline jwlr_view_index_bucket_t *jwlr_view_index_get_bucket(jwlr_view_index_t *index,
+                                                                   int32_t cx, int32_t cy)
+{
+    uint32_t hash = ((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u);
+    return &index->buckets[hash % JWLR_VIEW_INDEX_BUCKET_COUNT];
+}
 
-static Janet cfun_wlr_scene_node_place_above(int32_t argc, Janet *argv)
+
+static void jwlr_view_index_grid_remove(jwlr_view_index_entry_t *entry)
 {
-    struct wlr_scene_node *node;
-    struct wlr_scene_node *sibling;
+    jwlr_view_index_t *index = entry->index;
 
-    janet_fixarity(argc, 2);
+    if (!(entry->in_grid)) {
+        return;
+    }
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    sibling = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
-    wlr_scene_node_place_above(node, sibling);
-    return janet_wrap_nil();
+    int32_t cx0 = jwlr_view_index_cell_coord(entry->box.x, index->cell_size);
+    int32_t cy0 = jwlr_view_index_cell_coord(entry->box.y, index->cell_size);
+    int32_t cx1 = jwlr_view_index_cell_coord(entry->box.x + entry->box.width - 1, index->cell_size);
+    int32_t cy1 = jwlr_view_index_cell_coord(entry->box.y + entry->box.height - 1, index->cell_size);
+
+    for (int32_t cy = cy0; cy <= cy1; cy++) {
+        for (int32_t cx = cx0; cx <= cx1; cx++) {
+            jwlr_view_index_bucket_t *bucket = jwlr_view_index_get_bucket(index, cx, cy);
+            for (int32_t i = 0; i < bucket->count; i++) {
+                jwlr_view_index_cell_ref_t *ref = &bucket->refs[i];
+                if (ref->entry == entry && ref->cx == cx && ref->cy == cy) {
+                    bucket->refs[i] = bucket->refs[bucket->count - 1];
+                    bucket->count--;
+                    break;
+                }
+            }
+        }
+    }
+
+    entry->in_grid = 0;
 }
 
 
-static Janet cfun_wlr_scene_node_place_below(int32_t argc, Janet *argv)
+static void jwlr_view_index_grid_insert(jwlr_view_index_entry_t *entry)
 {
-    struct wlr_scene_node *node;
-    struct wlr_scene_node *sibling;
+    jwlr_view_index_t *index = entry->index;
+    int lx, ly;
 
-    janet_fixarity(argc, 2);
+    if (entry->width <= 0 || entry->height <= 0) {
+        return;
+    }
+    wlr_scene_node_coords(entry->node, &lx, &ly);
+    entry->box.x = lx;
+    entry->box.y = ly;
+    entry->box.width = entry->width;
+    entry->box.height = entry->height;
+
+    int32_t cx0 = jwlr_view_index_cell_coord(entry->box.x, index->cell_size);
+    int32_t cy0 = jwlr_view_index_cell_coord(entry->box.y, index->cell_size);
+    int32_t cx1 = jwlr_view_index_cell_coord(entry->box.x + entry->box.width - 1, index->cell_size);
+    int32_t cy1 = jwlr_view_index_cell_coord(entry->box.y + entry->box.height - 1, index->cell_size);
+
+    for (int32_t cy = cy0; cy <= cy1; cy++) {
+        for (int32_t cx = cx0; cx <= cx1; cx++) {
+            jwlr_view_index_bucket_t *bucket = jwlr_view_index_get_bucket(index, cx, cy);
+            if (bucket->count >= bucket->capacity) {
+                int32_t capacity = bucket->capacity ? bucket->capacity * 2 : 8;
+                jwlr_view_index_cell_ref_t *refs = realloc(bucket->refs, capacity * sizeof(*refs));
+                if (!refs) {
+                    JANET_OUT_OF_MEMORY;
+                }
+                bucket->refs = refs;
+                bucket->capacity = capacity;
+            }
+            bucket->refs[bucket->count].cx = cx;
+            bucket->refs[bucket->count].cy = cy;
+            bucket->refs[bucket->count].entry = entry;
+            bucket->count++;
+        }
+    }
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    sibling = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
-    wlr_scene_node_place_below(node, sibling);
-    return janet_wrap_nil();
+    entry->in_grid = 1;
 }
 
 
-static Janet cfun_wlr_scene_node_at(int32_t argc, Janet *argv)
-{
-    struct wlr_scene_node *node;
-    double x, y;
+/* The number of index entries in the subtree rooted at a scene node, the
+   node itself included. Only nodes with a non-zero count have one. */
+typedef struct {
+    struct wlr_addon addon;
+    int64_t count;
+} jwlr_view_index_subtree_t;
 
-    struct wlr_scene_node *n_node;
-    double nx = 0, ny = 0;
-    Janet ret_tuple[3];
 
-    janet_fixarity(argc, 3);
+static void jwlr_view_index_subtree_addon_destroy(struct wlr_addon *addon)
+{
+    jwlr_view_index_subtree_t *subtree = wl_container_of(addon, subtree, addon);
+    wlr_addon_finish(&subtree->addon);
+    free(subtree);
+}
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    x = janet_getnumber(argv, 1);
-    y = janet_getnumber(argv, 2);
+static const struct wlr_addon_interface jwlr_view_index_subtree_addon_impl = {
+    .name = "janetland-view-index-subtree",
+    .destroy = jwlr_view_index_subtree_addon_destroy,
+};
 
-    n_node = wlr_scene_node_at(node, x, y, &nx, &ny);
-    if (n_node) {
-        ret_tuple[0] = janet_wrap_abstract(jl_pointer_to_abs_obj(n_node, &jwlr_at_wlr_scene_node));
-    } else {
-        ret_tuple[0] = janet_wrap_nil();
-    }
-    ret_tuple[1] = janet_wrap_number(nx);
-    ret_tuple[2] = janet_wrap_number(ny);
 
-    return janet_wrap_tuple(janet_tuple_n(ret_tuple, 3));
+static jwlr_view_index_subtree_t *jwlr_view_index_get_subtree(struct wlr_scene_node *node)
+{
+    struct wlr_addon *addon = wlr_addon_find(&node->addons, NULL, &jwlr_view_index_subtree_addon_impl);
+    if (!addon) {
+        return NULL;
+    }
+    jwlr_view_index_subtree_t *subtree = wl_container_of(addon, subtree, addon);
+    return subtree;
 }
 
 
-static Janet cfun_wlr_scene_node_raise_to_top(int32_t argc, Janet *argv)
+static int64_t jwlr_view_index_subtree_count(struct wlr_scene_node *node)
 {
-    struct wlr_scene_node *node;
+    jwlr_view_index_subtree_t *subtree = jwlr_view_index_get_subtree(node);
+    return subtree ? subtree->count : 0;
+}
 
-    janet_fixarity(argc, 1);
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    wlr_scene_node_raise_to_top(node);
-    return janet_wrap_nil();
+/* Adds delta to the subtree counts of node and all its ancestors */
+static void jwlr_view_index_subtree_adjust(struct wlr_scene_node *node, int64_t delta)
+{
+    for (; node; node = node->parent ? &node->parent->node : NULL) {
+        jwlr_view_index_subtree_t *subtree = jwlr_view_index_get_subtree(node);
+        if (!subtree) {
+            if (delta < 0) {
+                /* The addons of a node are gone before its children get
+                   destroyed, along with their entries */
+                continue;
+            }
+            subtree = malloc(sizeof(*subtree));
+            if (!subtree) {
+                JANET_OUT_OF_MEMORY;
+            }
+            subtree->count = 0;
+            wlr_addon_init(&subtree->addon, &node->addons, NULL, &jwlr_view_index_subtree_addon_impl);
+        }
+        subtree->count += delta;
+        if (subtree->count <= 0) {
+            jwlr_view_index_subtree_addon_destroy(&subtree->addon);
+        }
+    }
 }
 
 
-static Janet cfun_wlr_scene_node_lower_to_bottom(int32_t argc, Janet *argv)
+static void jwlr_view_index_entry_update(jwlr_view_index_entry_t *entry)
 {
-    struct wlr_scene_node *node;
+    jwlr_view_index_grid_remove(entry);
+    jwlr_view_index_grid_insert(entry);
+}
 
-    janet_fixarity(argc, 1);
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    wlr_scene_node_lower_to_bottom(node);
-    return janet_wrap_nil();
+static void jwlr_view_index_entry_free(jwlr_view_index_entry_t *entry)
+{
+    jwlr_view_index_grid_remove(entry);
+    jwlr_view_index_subtree_adjust(entry->node, -1);
+    wl_list_remove(&entry->destroy.link);
+    wl_list_remove(&entry->link);
+    free(entry);
+    jwlr_view_index_entry_count--;
 }
 
 
-static Janet cfun_wlr_scene_node_reparent(int32_t argc, Janet *argv)
+static void jwlr_view_index_entry_handle_destroy(struct wl_listener *listener, void *data)
 {
-    struct wlr_scene_node *node;
-    struct wlr_scene_tree *new_parent;
+    (void)data;
+    jwlr_view_index_entry_t *entry = wl_container_of(listener, entry, destroy);
+    jwlr_view_index_entry_free(entry);
+}
 
-    janet_fixarity(argc, 2);
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    new_parent = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_tree);
-    wlr_scene_node_reparent(node, new_parent);
-    return janet_wrap_nil();
+static jwlr_view_index_entry_t *jwlr_view_index_find_entry(jwlr_view_index_t *index,
+                                                           struct wlr_scene_node *node)
+{
+    struct wl_listener *listener;
+    wl_list_for_each(listener, &node->events.destroy.listener_list, link) {
+        if (listener->notify == jwlr_view_index_entry_handle_destroy) {
+            jwlr_view_index_entry_t *entry = wl_container_of(listener, entry, destroy);
+            if (entry->index == index) {
+                return entry;
+            }
+        }
+    }
+    return NULL;
 }
 
 
-static Janet cfun_wlr_scene_node_coords(int32_t argc, Janet *argv)
+/* Should be called whenever the layout coordinates of node may have changed.
+   Updates all index entries for node and its descendants. */
+static void jwlr_view_index_node_moved(struct wlr_scene_node *node)
 {
-    struct wlr_scene_node *node;
-
-    int lx, ly;
-    bool ret;
-    Janet ret_tuple[3];
+    struct wl_listener *listener;
 
-    janet_fixarity(argc, 1);
+    if (!jwlr_view_index_entry_count || !jwlr_view_index_subtree_count(node)) {
+        return;
+    }
+    wl_list_for_each(listener, &node->events.destroy.listener_list, link) {
+        if (listener->notify == jwlr_view_index_entry_handle_destroy) {
+            jwlr_view_index_entry_t *entry = wl_container_of(listener, entry, destroy);
+            jwlr_view_index_entry_update(entry);
+        }
+    }
 
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    ret = wlr_scene_node_coords(node, &lx, &ly);
-    ret_tuple[0] = janet_wrap_boolean(ret);
-    ret_tuple[1] = janet_wrap_integer(lx);
-    ret_tuple[2] = janet_wrap_integer(ly);
-    return janet_wrap_tuple(janet_tuple_n(ret_tuple, 3));
+    if (WLR_SCENE_NODE_TREE == node->type) {
+        struct wlr_scene_tree *tree = wl_container_of(node, tree, node);
+        struct wlr_scene_node *child;
+        wl_list_for_each(child, &tree->children, link) {
+            jwlr_view_index_node_moved(child);
+        }
+    }
 }
 
 
-static Janet cfun_wlr_scene_node_set_position(int32_t argc, Janet *argv)
+/* Scene nodes with index entries in their subtrees should only be
+   reparented through here, to keep the subtree counts right */
+static void jwlr_view_index_node_reparent(struct wlr_scene_node *node, struct wlr_scene_tree *new_parent)
 {
-    struct wlr_scene_node *node;
-    int x, y;
-
-    janet_fixarity(argc, 3);
-
-    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
-    x = janet_getinteger(argv, 1);
-    y = janet_getinteger(argv, 2);
+    int64_t count = jwlr_view_index_subtree_count(node);
 
-    wlr_scene_node_set_position(node, x, y);
-    return janet_wrap_nil();
+    if (count && node->parent) {
+        jwlr_view_index_subtree_adjust(&node->parent->node, -count);
+    }
+    wlr_scene_node_reparent(node, new_parent);
+    if (count && node->parent) {
+        jwlr_view_index_subtree_adjust(&node->parent->node, count);
+    }
+    jwlr_view_index_node_moved(node);
 }
 
 
-static int method_wlr_scene_tree_get(void *p, Janet key, Janet *out)
+static int method_view_index_gc(void *p, size_t len)
 {
-    struct wlr_scene_tree **tree_p = (struct wlr_scene_tree **)p;
-    struct wlr_scene_tree *tree = *tree_p;
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    jwlr_view_index_t *index = (jwlr_view_index_t *)p;
+    jwlr_view_index_entry_t *entry, *tmp;
 
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
+    wl_list_for_each_safe(entry, tmp, &index->entries, link) {
+        /* Skip the grid, it's freed as a whole below */
+        entry->in_grid = 0;
+        jwlr_view_index_entry_free(entry);
+    }
+    for (int i = 0; i < JWLR_VIEW_INDEX_BUCKET_COUNT; i++) {
+        free(index->buckets[i].refs);
     }
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
+    return 0;
+}
 
-    struct wl_list **list_p = get_abstract_struct_list_member(tree, kw, wlr_scene_tree_list_offsets);
-    if (list_p) {
-        *out = janet_wrap_abstract(list_p);
-        return 1;
-    }
 
-    if (!janet_cstrcmp(kw, "node")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&tree->node, &jwlr_at_wlr_scene_node));
-        return 1;
+static int method_view_index_gcmark(void *p, size_t len)
+{
+    (void)len;
+    jwlr_view_index_t *index = (jwlr_view_index_t *)p;
+    jwlr_view_index_entry_t *entry;
+
+    wl_list_for_each(entry, &index->entries, link) {
+        janet_mark(entry->value);
     }
 
     return 0;
 }
 
 
-static int method_wlr_scene_node_get(void *p, Janet key, Janet *out)
+static bool jwlr_scene_node_enabled_in_tree(struct wlr_scene_node *node)
 {
-    struct wlr_scene_node **node_p = (struct wlr_scene_node **)p;
-    struct wlr_scene_node *node = *node_p;
+    for (; node; node = node->parent ? &node->parent->node : NULL) {
+        if (!(node->enabled)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
+
+static int jwlr_scene_node_depth(struct wlr_scene_node *node)
+{
+    int depth = 0;
+    for (struct wlr_scene_tree *tree = node->parent; tree; tree = tree->node.parent) {
+        depth++;
     }
+    return depth;
+}
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
 
-    struct wl_signal **signal_p = get_abstract_struct_signal_member(node, kw, wlr_scene_node_signal_offsets);
-    if (signal_p) {
-        *out = janet_wrap_abstract(signal_p);
-        return 1;
+/* Whether a gets rendered above b */
+static bool jwlr_scene_node_is_above(struct wlr_scene_node *a, struct wlr_scene_node *b)
+{
+    int depth_a = jwlr_scene_node_depth(a);
+    int depth_b = jwlr_scene_node_depth(b);
+    struct wlr_scene_node *pa = a, *pb = b;
+
+    for (int d = depth_a; d > depth_b; d--) {
+        pa = &pa->parent->node;
+    }
+    for (int d = depth_b; d > depth_a; d--) {
+        pb = &pb->parent->node;
+    }
+    if (pa == pb) {
+        /* One is the ancestor of the other, children are drawn above their parents */
+        return depth_a > depth_b;
     }
 
-    if (!janet_cstrcmp(kw, "type")) {
-        if (node->type >= __WLR_SCENE_NODE_TYPE_DEFS_COUNT) {
-            janet_panicf("unknown node type from wlroots scene node: %d", node->type);
-        }
-        *out = janet_ckeywordv(wlr_scene_node_type_defs[node->type].name);
-        return 1;
+    while (pa->parent != pb->parent) {
+        pa = &pa->parent->node;
+        pb = &pb->parent->node;
     }
-    if (!janet_cstrcmp(kw, "parent")) {
-        if (!(node->parent)) {
-            *out = janet_wrap_nil();
-            return 1;
+    if (!(pa->parent)) {
+        /* Not in the same scene */
+        return false;
+    }
+
+    /* Siblings, later ones in the children list are drawn above */
+    for (struct wl_list *l = pa->link.next; l != &pa->parent->children; l = l->next) {
+        if (l == &pb->link) {
+            return false;
         }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(node->parent, &jwlr_at_wlr_scene_tree));
-        return 1;
     }
-    if (!janet_cstrcmp(kw, "enabled")) {
-        *out = janet_wrap_boolean(node->enabled);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "x")) {
-        *out = janet_wrap_integer(node->x);
-        return 1;
+    return true;
+}
+
+
+static void jwlr_get_color(const Janet *argv, int32_t n, float color[static 4])
+{
+    JanetView color_view = janet_getindexed(argv, n);
+
+    if (4 != color_view.len) {
+        janet_panicf("expected color in the form of [r g b a], got %v", argv[n]);
     }
-    if (!janet_cstrcmp(kw, "y")) {
-        *out = janet_wrap_integer(node->y);
-        return 1;
+    for (int32_t i = 0; i < 4; i++) {
+        color[i] = (float)janet_getnumber(color_view.items, i);
     }
-    if (!janet_cstrcmp(kw, "data")) {
-        if (!(node->data)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_pointer(node->data);
-        return 1;
+}
+
+
+static Janet cfun_wlr_scene_rect_create(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_tree *parent;
+    int width, height;
+    float color[4];
+
+    struct wlr_scene_rect *rect;
+
+    janet_fixarity(argc, 4);
+
+    parent = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_tree);
+    width = janet_getinteger(argv, 1);
+    height = janet_getinteger(argv, 2);
+    jwlr_get_color(argv, 3, color);
+
+    rect = wlr_scene_rect_create(parent, width, height, color);
+    if (!rect) {
+        janet_panic("failed to create wlroots scene rect object");
     }
+    return janet_wrap_abstract(jl_pointer_to_abs_obj(rect, &jwlr_at_wlr_scene_rect));
+}
 
-    return 0;
+
+static Janet cfun_wlr_scene_rect_set_size(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_rect *rect;
+    int width, height;
+
+    janet_fixarity(argc, 3);
+
+    rect = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_rect);
+    width = janet_getinteger(argv, 1);
+    height = janet_getinteger(argv, 2);
+
+    wlr_scene_rect_set_size(rect, width, height);
+    return janet_wrap_nil();
 }
 
-static void method_wlr_scene_node_put(void *p, Janet key, Janet value) {
-    struct wlr_scene_node **node_p = (struct wlr_scene_node **)p;
-    struct wlr_scene_node *node = *node_p;
 
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
-    }
+static Janet cfun_wlr_scene_rect_set_color(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_rect *rect;
+    float color[4];
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
+    janet_fixarity(argc, 2);
 
-    if (!janet_cstrcmp(kw, "data")) {
-        node->data = jl_value_to_data_pointer(value);
-        return;
-    }
+    rect = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_rect);
+    jwlr_get_color(argv, 1, color);
 
-    janet_panicf("unknown key: %v", key);
+    wlr_scene_rect_set_color(rect, color);
+    return janet_wrap_nil();
 }
 
-static int method_wlr_input_device_get(void *p, Janet key, Janet *out)
+
+static Janet cfun_wlr_scene_rect_from_node(int32_t argc, Janet *argv)
 {
-    struct wlr_input_device **device_p = (struct wlr_input_device **)p;
-    struct wlr_input_device *device = *device_p;
+    struct wlr_scene_node *node;
 
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
+    janet_fixarity(argc, 1);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    if (node->type != WLR_SCENE_NODE_RECT) {
+        janet_panic("not a rect node");
     }
+    return janet_wrap_abstract(jl_pointer_to_abs_obj(wlr_scene_rect_from_node(node),
+                                                     &jwlr_at_wlr_scene_rect));
+}
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
 
-    struct wl_signal **signal_p = get_abstract_struct_signal_member(device, kw, wlr_input_device_signal_offsets);
-    if (signal_p) {
-        *out = janet_wrap_abstract(signal_p);
-        return 1;
+static Janet cfun_wlr_scene_rect_set_border(int32_t argc, Janet *argv)
+{
+    JanetView rects_view;
+    struct wlr_box *box;
+    int border_width;
+    float color[4];
+    int set_color = 0;
+
+    struct wlr_scene_rect *rects[4];
+
+    janet_arity(argc, 3, 4);
+
+    rects_view = janet_getindexed(argv, 0);
+    if (4 != rects_view.len) {
+        janet_panicf("expected [top right bottom left] border rects, got %v", argv[0]);
+    }
+    for (int32_t i = 0; i < 4; i++) {
+        rects[i] = jl_get_abs_obj_pointer(rects_view.items, i, &jwlr_at_wlr_scene_rect);
+    }
+    box = janet_getabstract(argv, 1, &jwlr_at_box);
+    border_width = janet_getinteger(argv, 2);
+    if (argc > 3 && !janet_checktype(argv[3], JANET_NIL)) {
+        jwlr_get_color(argv, 3, color);
+        set_color = 1;
+    }
+
+    int outer_width = box->width + 2 * border_width;
+
+    /* top */
+    wlr_scene_node_set_position(&rects[0]->node, box->x - border_width, box->y - border_width);
+    wlr_scene_rect_set_size(rects[0], outer_width, border_width);
+    /* right */
+    wlr_scene_node_set_position(&rects[1]->node, box->x + box->width, box->y);
+    wlr_scene_rect_set_size(rects[1], border_width, box->height);
+    /* bottom */
+    wlr_scene_node_set_position(&rects[2]->node, box->x - border_width, box->y + box->height);
+    wlr_scene_rect_set_size(rects[2], outer_width, border_width);
+    /* left */
+    wlr_scene_node_set_position(&rects[3]->node, box->x - border_width, box->y);
+    wlr_scene_rect_set_size(rects[3], border_width, box->height);
+
+    if (set_color) {
+        for (int i = 0; i < 4; i++) {
+            wlr_scene_rect_set_color(rects[i], color);
+        }
     }
 
-    if (!janet_cstrcmp(kw, "type")) {
-        if (device->type >= __WLR_INPUT_DEVICE_DEFS_COUNT) {
-            janet_panicf("unknown device type from wlroots input device: %d", device->type);
+    return janet_wrap_nil();
+}
+
+
+/* A wlr_buffer backed by a shared memory file, which Janet code draws into
+   with wlr-shm-buffer-write. The mapping is never handed out as a Janet
+   buffer, since it goes away with the wlr_buffer, which is refcounted by
+   wlroots and may be dropped when the Janet object is collected. */
+typedef struct {
+    struct wlr_buffer base;
+    int fd;
+    void *data;
+    size_t size;
+    int stride;
+    uint32_t format;
+} jwlr_shm_buffer_t;
+
+typedef struct {
+    jwlr_shm_buffer_t *buffer;
+} jwlr_shm_buffer_obj_t;
+
+
+static void jwlr_shm_buffer_destroy(struct wlr_buffer *wlr_buffer)
+{
+    jwlr_shm_buffer_t *buffer = wl_container_of(wlr_buffer, buffer, base);
+
+    munmap(buffer->data, buffer->size);
+    close(buffer->fd);
+    free(buffer);
+}
+
+static bool jwlr_shm_buffer_get_shm(struct wlr_buffer *wlr_buffer, struct wlr_shm_attributes *attribs)
+{
+    jwlr_shm_buffer_t *buffer = wl_container_of(wlr_buffer, buffer, base);
+
+    attribs->fd = buffer->fd;
+    attribs->format = buffer->format;
+    attribs->width = buffer->base.width;
+    attribs->height = buffer->base.height;
+    attribs->stride = buffer->stride;
+    attribs->offset = 0;
+    return true;
+}
+
+static bool jwlr_shm_buffer_begin_data_ptr_access(struct wlr_buffer *wlr_buffer, uint32_t flags,
+                                                  void **data, uint32_t *format, size_t *stride)
+{
+    (void)flags;
+    jwlr_shm_buffer_t *buffer = wl_container_of(wlr_buffer, buffer, base);
+
+    *data = buffer->data;
+    *format = buffer->format;
+    *stride = buffer->stride;
+    return true;
+}
+
+static void jwlr_shm_buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer)
+{
+    (void)wlr_buffer;
+}
+
+static const struct wlr_buffer_impl jwlr_shm_buffer_impl = {
+    .destroy = jwlr_shm_buffer_destroy,
+    .get_shm = jwlr_shm_buffer_get_shm,
+    .begin_data_ptr_access = jwlr_shm_buffer_begin_data_ptr_access,
+    .end_data_ptr_access = jwlr_shm_buffer_end_data_ptr_access,
+};
+
+
+static int jwlr_allocate_shm_file(size_t size)
+{
+    char name[] = "/janetland-shm-XXXXXX";
+    struct timespec ts;
+    int fd = -1;
+
+    for (int retries = 100; retries > 0 && fd < 0; retries--) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        long r = ts.tv_nsec ^ (long)getpid();
+        for (int i = sizeof(name) - 7; i < (int)sizeof(name) - 1; i++) {
+            name[i] = 'A' + (r & 15) + (r & 16) * 2;
+            r >>= 5;
+        }
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            shm_unlink(name);
+        } else if (EEXIST != errno) {
+            return -1;
         }
-        *out = janet_ckeywordv(wlr_input_device_defs[device->type].name);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "vendor")) {
-        /* XXX: unsigned int -> int32_t conversion */
-        *out = janet_wrap_integer(device->vendor);
-        return 1;
     }
-    if (!janet_cstrcmp(kw, "product")) {
-        /* XXX: unsigned int -> int32_t conversion */
-        *out = janet_wrap_integer(device->product);
-        return 1;
+    if (fd < 0) {
+        return -1;
     }
-    if (!janet_cstrcmp(kw, "name")) {
-        if (!(device->name)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_cstringv(device->name);
-        return 1;
+
+    int ret;
+    do {
+        ret = ftruncate(fd, size);
+    } while (ret < 0 && EINTR == errno);
+    if (ret < 0) {
+        close(fd);
+        return -1;
     }
-    if (!janet_cstrcmp(kw, "data")) {
-        if (!(device->data)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_pointer(device->data);
-        return 1;
+    return fd;
+}
+
+
+static void jwlr_shm_buffer_obj_drop(jwlr_shm_buffer_obj_t *obj)
+{
+    if (obj->buffer) {
+        wlr_buffer_drop(&obj->buffer->base);
+        obj->buffer = NULL;
     }
+}
+
 
+static int method_shm_buffer_gc(void *p, size_t len)
+{
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    jwlr_shm_buffer_obj_drop((jwlr_shm_buffer_obj_t *)p);
     return 0;
 }
 
 
-static int method_wlr_pointer_get(void *p, Janet key, Janet *out)
+static int method_shm_buffer_get(void *p, Janet key, Janet *out)
 {
-    struct wlr_pointer **pointer_p = (struct wlr_pointer **)p;
-    struct wlr_pointer *pointer = *pointer_p;
-    
+    jwlr_shm_buffer_obj_t *obj = (jwlr_shm_buffer_obj_t *)p;
+
     if (!janet_checktype(key, JANET_KEYWORD)) {
         janet_panicf("expected keyword, got %v", key);
     }
+    if (!(obj->buffer)) {
+        janet_panic("shm buffer is already destroyed");
+    }
 
     const uint8_t *kw = janet_unwrap_keyword(key);
 
-    struct wl_signal **signal_p = get_abstract_struct_signal_member(pointer, kw, wlr_pointer_signal_offsets);
-    if (signal_p) {
-        *out = janet_wrap_abstract(signal_p);
-        return 1;
-    }
-
-    if (!janet_cstrcmp(kw, "base")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&pointer->base, &jwlr_at_wlr_input_device));
+    if (!janet_cstrcmp(kw, "width")) {
+        *out = janet_wrap_integer(obj->buffer->base.width);
         return 1;
     }
-    if (!janet_cstrcmp(kw, "output-name")) {
-        *out = janet_cstringv(pointer->output_name);
+    if (!janet_cstrcmp(kw, "height")) {
+        *out = janet_wrap_integer(obj->buffer->base.height);
         return 1;
     }
-    if (!janet_cstrcmp(kw, "data")) {
-        if (!(pointer->data)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_pointer(pointer->data);
+    if (!janet_cstrcmp(kw, "stride")) {
+        *out = janet_wrap_integer(obj->buffer->stride);
         return 1;
     }
-
     return 0;
 }
 
 
-static int method_wlr_keyboard_modifiers_get(void *p, Janet key, Janet *out)
+static jwlr_shm_buffer_t *jwlr_get_shm_buffer(const Janet *argv, int32_t n)
 {
-    struct wlr_keyboard_modifiers **modifiers_p = (struct wlr_keyboard_modifiers **)p;
-    struct wlr_keyboard_modifiers *modifiers = *modifiers_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
+    jwlr_shm_buffer_obj_t *obj = janet_getabstract(argv, n, &jwlr_at_shm_buffer);
+    if (!(obj->buffer)) {
+        janet_panicf("shm buffer %v is already destroyed", argv[n]);
     }
+    return obj->buffer;
+}
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
-    xkb_mod_mask_t *member_p;
 
-    if (!janet_cstrcmp(kw, "depressed")) {
-        member_p = &modifiers->depressed;
-    } else if (!janet_cstrcmp(kw, "latched")) {
-        member_p = &modifiers->latched;
-    } else if (!janet_cstrcmp(kw, "locked")) {
-        member_p = &modifiers->locked;
-    } else if (!janet_cstrcmp(kw, "group")) {
-        member_p = &modifiers->group;
-    } else {
-        return 0;
+static Janet cfun_wlr_shm_buffer_create(int32_t argc, Janet *argv)
+{
+    int32_t width, height;
+
+    jwlr_shm_buffer_t *buffer;
+    jwlr_shm_buffer_obj_t *obj;
+    int stride;
+    size_t size;
+    int fd;
+    void *data;
+
+    janet_fixarity(argc, 2);
+
+    width = janet_getnat(argv, 0);
+    height = janet_getnat(argv, 1);
+    if (width <= 0 || height <= 0) {
+        janet_panicf("invalid buffer size: %dx%d", width, height);
+    }
+    stride = width * 4;
+    size = (size_t)stride * height;
+    if (size > INT32_MAX) {
+        janet_panicf("buffer too large: %dx%d", width, height);
     }
 
-    *out = janet_wrap_array(jl_get_flag_keys(*member_p, wlr_keyboard_modifier_defs));
-    return 1;
+    fd = jwlr_allocate_shm_file(size);
+    if (fd < 0) {
+        janet_panicf("failed to allocate shared memory: %d", errno);
+    }
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == data) {
+        int err = errno;
+        close(fd);
+        janet_panicf("failed to map shared memory: %d", err);
+    }
+
+    buffer = malloc(sizeof(*buffer));
+    if (!buffer) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memset(buffer, 0, sizeof(*buffer));
+    wlr_buffer_init(&buffer->base, &jwlr_shm_buffer_impl, width, height);
+    buffer->fd = fd;
+    buffer->data = data;
+    buffer->size = size;
+    buffer->stride = stride;
+    buffer->format = DRM_FORMAT_ARGB8888;
+
+    obj = janet_abstract(&jwlr_at_shm_buffer, sizeof(*obj));
+    obj->buffer = buffer;
+    return janet_wrap_abstract(obj);
 }
 
 
-static int method_wlr_keyboard_key_event_get(void *p, Janet key, Janet *out)
+static Janet cfun_wlr_shm_buffer_write(int32_t argc, Janet *argv)
 {
-    struct wlr_keyboard_key_event **event_p = (struct wlr_keyboard_key_event **)p;
-    struct wlr_keyboard_key_event *event = *event_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
+    jwlr_shm_buffer_t *buffer;
+    JanetByteView bytes;
+    int32_t offset = 0;
+
+    janet_arity(argc, 2, 3);
+
+    buffer = jwlr_get_shm_buffer(argv, 0);
+    bytes = janet_getbytes(argv, 1);
+    if (argc > 2) {
+        offset = janet_getnat(argv, 2);
+    }
+    if ((size_t)offset + (size_t)bytes.len > buffer->size) {
+        janet_panicf("writing %d bytes at offset %d overflows the buffer (%d bytes)",
+                     bytes.len, offset, (int32_t)buffer->size);
     }
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
+    memcpy((uint8_t *)buffer->data + offset, bytes.bytes, bytes.len);
+    return janet_wrap_nil();
+}
 
-    if (!janet_cstrcmp(kw, "time-msec")) {
-        /* uint32_t -> uint64_t */
-        *out = janet_wrap_u64(event->time_msec);
-        return 1;
+
+/* Copies a rect of pixels, so that updating a damaged area takes a single
+   call instead of one per row */
+static Janet cfun_wlr_shm_buffer_write_rect(int32_t argc, Janet *argv)
+{
+    jwlr_shm_buffer_t *buffer;
+    int32_t x, y, width, height;
+    JanetByteView src;
+    int32_t src_stride;
+
+    size_t row_size;
+    uint8_t *dst;
+
+    janet_arity(argc, 6, 7);
+
+    buffer = jwlr_get_shm_buffer(argv, 0);
+    x = janet_getnat(argv, 1);
+    y = janet_getnat(argv, 2);
+    width = janet_getnat(argv, 3);
+    height = janet_getnat(argv, 4);
+    src = janet_getbytes(argv, 5);
+    src_stride = janet_optnat(argv, argc, 6, width * 4);
+
+    if (x + width > buffer->base.width || y + height > buffer->base.height) {
+        janet_panicf("rect %dx%d at (%d, %d) is out of the buffer (%dx%d)",
+                     width, height, x, y, buffer->base.width, buffer->base.height);
     }
-    if (!janet_cstrcmp(kw, "keycode")) {
-        /* uint32_t -> uint64_t */
-        *out = janet_wrap_u64(event->keycode);
-        return 1;
+    if (0 == width || 0 == height) {
+        return janet_wrap_nil();
     }
-    if (!janet_cstrcmp(kw, "update-state")) {
-        *out = janet_wrap_boolean(event->update_state);
-        return 1;
+    row_size = (size_t)width * 4;
+    if ((size_t)src_stride < row_size) {
+        janet_panicf("source stride %d is smaller than a row (%d bytes)", src_stride, (int32_t)row_size);
     }
-    if (!janet_cstrcmp(kw, "state")) {
-        *out = janet_ckeywordv(wl_keyboard_key_state_defs[event->state].name);
-        return 1;
+    if ((size_t)src_stride * (height - 1) + row_size > (size_t)src.len) {
+        janet_panicf("source is too short for a %dx%d rect: %d bytes", width, height, src.len);
     }
 
-    return 0;
+    dst = (uint8_t *)buffer->data + (size_t)y * buffer->stride + (size_t)x * 4;
+    for (int32_t row = 0; row < height; row++) {
+        memcpy(dst + (size_t)row * buffer->stride, src.bytes + (size_t)row * src_stride, row_size);
+    }
+    return janet_wrap_nil();
 }
 
 
-static int method_wlr_keyboard_get(void *p, Janet key, Janet *out)
+static Janet cfun_wlr_shm_buffer_read(int32_t argc, Janet *argv)
 {
-    struct wlr_keyboard **keyboard_p = (struct wlr_keyboard **)p;
-    struct wlr_keyboard *keyboard = *keyboard_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
-    }
+    jwlr_shm_buffer_t *buffer;
+    int32_t offset = 0;
+    int32_t len;
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
+    JanetBuffer *out;
 
-    struct wl_signal **signal_p = get_abstract_struct_signal_member(keyboard, kw, wlr_keyboard_signal_offsets);
-    if (signal_p) {
-        *out = janet_wrap_abstract(signal_p);
-        return 1;
-    }
+    janet_arity(argc, 1, 3);
 
-    if (!janet_cstrcmp(kw, "base")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&keyboard->base, &jwlr_at_wlr_input_device));
-        return 1;
+    buffer = jwlr_get_shm_buffer(argv, 0);
+    if (argc > 1) {
+        offset = janet_getnat(argv, 1);
     }
-    if (!janet_cstrcmp(kw, "keymap-string")) {
-        if (!(keyboard->keymap_string)) {
-            *out = janet_wrap_nil();
-            return 1;
+    if ((size_t)offset > buffer->size) {
+        janet_panicf("offset %d is out of range (%d bytes)", offset, (int32_t)buffer->size);
+    }
+    len = (int32_t)(buffer->size - offset);
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        len = janet_getnat(argv, 2);
+        if ((size_t)offset + (size_t)len > buffer->size) {
+            janet_panicf("reading %d bytes at offset %d overflows the buffer (%d bytes)",
+                         len, offset, (int32_t)buffer->size);
+        }
+    }
+
+    out = janet_buffer(len);
+    janet_buffer_push_bytes(out, (const uint8_t *)buffer->data + offset, len);
+    return janet_wrap_buffer(out);
+}
+
+
+static Janet cfun_wlr_shm_buffer_destroy(int32_t argc, Janet *argv)
+{
+    jwlr_shm_buffer_obj_t *obj;
+
+    janet_fixarity(argc, 1);
+
+    obj = janet_getabstract(argv, 0, &jwlr_at_shm_buffer);
+    jwlr_shm_buffer_obj_drop(obj);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_buffer_create(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_tree *parent;
+    jwlr_shm_buffer_t *buffer = NULL;
+
+    struct wlr_scene_buffer *scene_buffer;
+
+    janet_fixarity(argc, 2);
+
+    parent = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_tree);
+    if (!janet_checktype(argv[1], JANET_NIL)) {
+        buffer = jwlr_get_shm_buffer(argv, 1);
+    }
+
+    scene_buffer = wlr_scene_buffer_create(parent, buffer ? &buffer->base : NULL);
+    if (!scene_buffer) {
+        janet_panic("failed to create wlroots scene buffer object");
+    }
+    return janet_wrap_abstract(jl_pointer_to_abs_obj(scene_buffer, &jwlr_at_wlr_scene_buffer));
+}
+
+
+static Janet cfun_wlr_scene_buffer_set_buffer_with_damage(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_buffer *scene_buffer;
+    jwlr_shm_buffer_t *buffer = NULL;
+    struct wlr_box *damage_box = NULL;
+
+    pixman_region32_t damage;
+
+    janet_arity(argc, 2, 3);
+
+    scene_buffer = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_buffer);
+    if (!janet_checktype(argv[1], JANET_NIL)) {
+        buffer = jwlr_get_shm_buffer(argv, 1);
+    }
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        damage_box = janet_getabstract(argv, 2, &jwlr_at_box);
+    }
+
+    if (!damage_box || !buffer) {
+        /* wlroots asserts there's no damage without a buffer */
+        wlr_scene_buffer_set_buffer(scene_buffer, buffer ? &buffer->base : NULL);
+        return janet_wrap_nil();
+    }
+
+    pixman_region32_init_rect(&damage, damage_box->x, damage_box->y,
+                              damage_box->width, damage_box->height);
+    wlr_scene_buffer_set_buffer_with_damage(scene_buffer, &buffer->base, &damage);
+    pixman_region32_fini(&damage);
+    return janet_wrap_nil();
+}
+
+
+/* Animations are advanced in C on every output frame, and Janet code is
+   only called when an animation finishes or gets cancelled. Animators are
+   rooted until wlr-animator-destroy is called, since the frame listeners
+   point to them. */
+typedef struct {
+    struct wl_list animations;
+    struct wl_list outputs;
+} jwlr_animator_t;
+
+typedef struct {
+    jwlr_animator_t *animator;
+    struct wlr_output *output;
+    struct wl_listener frame;
+    struct wl_listener destroy;
+    struct wl_list link;
+} jwlr_animator_output_t;
+
+typedef struct {
+    jwlr_animator_t *animator;
+    struct wlr_scene_node *node;
+    struct wl_listener node_destroy;
+    struct wl_list link;
+    int property;
+    int easing;
+    int from_x, from_y;
+    int to_x, to_y;
+    struct timespec start;
+    int32_t duration_ms;
+    JanetFunction *on_done;
+} jwlr_animation_t;
+
+
+static void jwlr_animation_call_on_done(JanetFunction *on_done, int finished)
+{
+    Janet argv[] = {
+        janet_wrap_boolean(finished),
+    };
+    Janet ret = janet_wrap_nil();
+    JanetFiber *fiber = NULL;
+
+    int locked = janet_gclock();
+    int sig = janet_pcall(on_done, 1, argv, &ret, &fiber);
+    janet_gcunlock(locked);
+    if (JANET_SIGNAL_OK != sig) {
+        janet_stacktrace(fiber, ret);
+    }
+}
+
+
+/* Frees the animation, and calls its on_done callback (if any) */
+static void jwlr_animation_finish(jwlr_animation_t *animation, int finished)
+{
+    JanetFunction *on_done = animation->on_done;
+
+    wl_list_remove(&animation->node_destroy.link);
+    wl_list_remove(&animation->link);
+    free(animation);
+
+    if (on_done) {
+        /* The animator holds the only reference, keep it alive during the call */
+        janet_gcroot(janet_wrap_function(on_done));
+        jwlr_animation_call_on_done(on_done, finished);
+        janet_gcunroot(janet_wrap_function(on_done));
+    }
+}
+
+
+static void jwlr_animation_handle_node_destroy(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_animation_t *animation = wl_container_of(listener, animation, node_destroy);
+    jwlr_animation_finish(animation, 0);
+}
+
+
+static double jwlr_animation_ease(int easing, double t)
+{
+    switch (easing) {
+    case JWLR_EASING_EASE_IN:
+        return t * t * t;
+    case JWLR_EASING_EASE_OUT:
+        return 1.0 - (1.0 - t) * (1.0 - t) * (1.0 - t);
+    case JWLR_EASING_EASE_IN_OUT:
+        if (t < 0.5) {
+            return 4.0 * t * t * t;
+        } else {
+            double u = -2.0 * t + 2.0;
+            return 1.0 - u * u * u / 2.0;
+        }
+    case JWLR_EASING_LINEAR:
+    default:
+        return t;
+    }
+}
+
+
+static void jwlr_animation_get_size(struct wlr_scene_node *node, int *width, int *height)
+{
+    switch (node->type) {
+    case WLR_SCENE_NODE_RECT: {
+        struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+        *width = rect->width;
+        *height = rect->height;
+        break;
+    }
+    case WLR_SCENE_NODE_BUFFER: {
+        struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+        *width = buffer->dst_width;
+        *height = buffer->dst_height;
+        if ((0 == *width || 0 == *height) && buffer->buffer) {
+            *width = buffer->buffer->width;
+            *height = buffer->buffer->height;
+        }
+        break;
+    }
+    default:
+        janet_panic("only rect and buffer nodes can be resized");
+    }
+}
+
+
+static void jwlr_animation_apply(jwlr_animation_t *animation, double progress)
+{
+    double e = jwlr_animation_ease(animation->easing, progress);
+    int x = animation->from_x + (int)lround((animation->to_x - animation->from_x) * e);
+    int y = animation->from_y + (int)lround((animation->to_y - animation->from_y) * e);
+    struct wlr_scene_node *node = animation->node;
+
+    if (JWLR_ANIMATION_POSITION == animation->property) {
+        wlr_scene_node_set_position(node, x, y);
+        jwlr_view_index_node_moved(node);
+    } else if (WLR_SCENE_NODE_RECT == node->type) {
+        wlr_scene_rect_set_size(wlr_scene_rect_from_node(node), x, y);
+    } else {
+        wlr_scene_buffer_set_dest_size(wlr_scene_buffer_from_node(node), x, y);
+    }
+}
+
+
+static void jwlr_animator_tick(jwlr_animator_t *animator)
+{
+    struct timespec now;
+    jwlr_animation_t *animation, *tmp;
+    struct wl_list done;
+    uint64_t trace_start;
+
+    if (wl_list_empty(&animator->animations)) {
+        return;
+    }
+
+    trace_start = jwlr_trace_begin();
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    wl_list_init(&done);
+
+    wl_list_for_each_safe(animation, tmp, &animator->animations, link) {
+        double elapsed_ms = (now.tv_sec - animation->start.tv_sec) * 1000.0 +
+            (now.tv_nsec - animation->start.tv_nsec) / 1000000.0;
+        double progress = animation->duration_ms > 0 ? elapsed_ms / animation->duration_ms : 1.0;
+        if (progress >= 1.0) {
+            jwlr_animation_apply(animation, 1.0);
+            wl_list_remove(&animation->link);
+            wl_list_insert(done.prev, &animation->link);
+        } else if (progress > 0.0) {
+            jwlr_animation_apply(animation, progress);
+        }
+    }
+
+    if (!wl_list_empty(&animator->animations)) {
+        /* Keep the frames coming, even if the moved nodes didn't cause any damage */
+        jwlr_animator_output_t *aoutput;
+        wl_list_for_each(aoutput, &animator->outputs, link) {
+            wlr_output_schedule_frame(aoutput->output);
+        }
+    }
+
+    /* These already finished, so destroying their nodes from a callback
+       below shouldn't cancel them. The listener links stay valid for
+       jwlr_animation_finish() to remove. */
+    wl_list_for_each(animation, &done, link) {
+        wl_list_remove(&animation->node_destroy.link);
+        wl_list_init(&animation->node_destroy.link);
+    }
+
+    /* Callbacks may add new animations, so they are called after the loop
+       above. They may also free anything, so always restart from the head. */
+    while (!wl_list_empty(&done)) {
+        animation = wl_container_of(done.next, animation, link);
+        jwlr_animation_finish(animation, 1);
+    }
+
+    jwlr_trace_end("animation", "animator-tick", trace_start);
+}
+
+
+static void jwlr_animator_output_free(jwlr_animator_output_t *aoutput)
+{
+    wl_list_remove(&aoutput->frame.link);
+    wl_list_remove(&aoutput->destroy.link);
+    wl_list_remove(&aoutput->link);
+    free(aoutput);
+}
+
+
+static void jwlr_animator_output_handle_frame(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_animator_output_t *aoutput = wl_container_of(listener, aoutput, frame);
+    jwlr_animator_tick(aoutput->animator);
+}
+
+
+static void jwlr_animator_output_handle_destroy(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_animator_output_t *aoutput = wl_container_of(listener, aoutput, destroy);
+    jwlr_animator_output_free(aoutput);
+}
+
+
+static int method_animator_gcmark(void *p, size_t len)
+{
+    (void)len;
+    jwlr_animator_t *animator = (jwlr_animator_t *)p;
+    jwlr_animation_t *animation;
+
+    wl_list_for_each(animation, &animator->animations, link) {
+        if (animation->on_done) {
+            janet_mark(janet_wrap_function(animation->on_done));
+        }
+    }
+
+    return 0;
+}
+
+
+static jwlr_animation_t *jwlr_animator_find(jwlr_animator_t *animator,
+                                            struct wlr_scene_node *node,
+                                            int property)
+{
+    jwlr_animation_t *animation;
+    wl_list_for_each(animation, &animator->animations, link) {
+        if (animation->node == node && (property < 0 || animation->property == property)) {
+            return animation;
+        }
+    }
+    return NULL;
+}
+
+
+static Janet cfun_wlr_animator_create(int32_t argc, Janet *argv)
+{
+    (void)argv;
+    jwlr_animator_t *animator;
+
+    janet_fixarity(argc, 0);
+
+    animator = janet_abstract(&jwlr_at_animator, sizeof(*animator));
+    wl_list_init(&animator->animations);
+    wl_list_init(&animator->outputs);
+    janet_gcroot(janet_wrap_abstract(animator));
+    return janet_wrap_abstract(animator);
+}
+
+
+static Janet cfun_wlr_animator_destroy(int32_t argc, Janet *argv)
+{
+    jwlr_animator_t *animator;
+
+    jwlr_animator_output_t *aoutput, *aoutput_tmp;
+    jwlr_animation_t *animation;
+
+    janet_fixarity(argc, 1);
+
+    animator = janet_getabstract(argv, 0, &jwlr_at_animator);
+    wl_list_for_each_safe(aoutput, aoutput_tmp, &animator->outputs, link) {
+        jwlr_animator_output_free(aoutput);
+    }
+    while (!wl_list_empty(&animator->animations)) {
+        animation = wl_container_of(animator->animations.next, animation, link);
+        jwlr_animation_finish(animation, 0);
+    }
+    janet_gcunroot(janet_wrap_abstract(animator));
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_animator_attach_output(int32_t argc, Janet *argv)
+{
+    jwlr_animator_t *animator;
+    struct wlr_output *output;
+
+    jwlr_animator_output_t *aoutput;
+
+    janet_fixarity(argc, 2);
+
+    animator = janet_getabstract(argv, 0, &jwlr_at_animator);
+    output = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_output);
+
+    wl_list_for_each(aoutput, &animator->outputs, link) {
+        if (aoutput->output == output) {
+            return janet_wrap_nil();
+        }
+    }
+
+    aoutput = malloc(sizeof(*aoutput));
+    if (!aoutput) {
+        JANET_OUT_OF_MEMORY;
+    }
+    aoutput->animator = animator;
+    aoutput->output = output;
+    aoutput->frame.notify = jwlr_animator_output_handle_frame;
+    wl_signal_add(&output->events.frame, &aoutput->frame);
+    aoutput->destroy.notify = jwlr_animator_output_handle_destroy;
+    wl_signal_add(&output->events.destroy, &aoutput->destroy);
+    wl_list_insert(&animator->outputs, &aoutput->link);
+
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_animator_animate(int32_t argc, Janet *argv)
+{
+    jwlr_animator_t *animator;
+    struct wlr_scene_node *node;
+    int property;
+    int to_x, to_y;
+    int32_t duration_ms;
+    int easing = JWLR_EASING_EASE_OUT;
+    JanetFunction *on_done = NULL;
+
+    jwlr_animation_t *animation;
+    jwlr_animator_output_t *aoutput;
+
+    janet_arity(argc, 6, 8);
+
+    animator = janet_getabstract(argv, 0, &jwlr_at_animator);
+    node = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+    property = jl_get_key_def(argv, 2, animation_property_defs);
+    to_x = janet_getinteger(argv, 3);
+    to_y = janet_getinteger(argv, 4);
+    duration_ms = janet_getnat(argv, 5);
+    if (argc > 6 && !janet_checktype(argv[6], JANET_NIL)) {
+        easing = jl_get_key_def(argv, 6, animation_easing_defs);
+    }
+    if (argc > 7 && !janet_checktype(argv[7], JANET_NIL)) {
+        on_done = janet_getfunction(argv, 7);
+    }
+
+    animation = jwlr_animator_find(animator, node, property);
+    if (animation) {
+        /* Replaced by the new animation, which starts from the current state */
+        jwlr_animation_finish(animation, 0);
+    }
+
+    animation = malloc(sizeof(*animation));
+    if (!animation) {
+        JANET_OUT_OF_MEMORY;
+    }
+    animation->animator = animator;
+    animation->node = node;
+    animation->property = property;
+    animation->easing = easing;
+    if (JWLR_ANIMATION_POSITION == property) {
+        animation->from_x = node->x;
+        animation->from_y = node->y;
+    } else {
+        jwlr_animation_get_size(node, &animation->from_x, &animation->from_y);
+    }
+    animation->to_x = to_x;
+    animation->to_y = to_y;
+    animation->duration_ms = duration_ms;
+    animation->on_done = on_done;
+    clock_gettime(CLOCK_MONOTONIC, &animation->start);
+
+    animation->node_destroy.notify = jwlr_animation_handle_node_destroy;
+    wl_signal_add(&node->events.destroy, &animation->node_destroy);
+    wl_list_insert(animator->animations.prev, &animation->link);
+
+    wl_list_for_each(aoutput, &animator->outputs, link) {
+        wlr_output_schedule_frame(aoutput->output);
+    }
+
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_animator_cancel(int32_t argc, Janet *argv)
+{
+    jwlr_animator_t *animator;
+    struct wlr_scene_node *node;
+    int property = -1;
+
+    jwlr_animation_t *animation;
+    int cancelled = 0;
+
+    janet_arity(argc, 2, 3);
+
+    animator = janet_getabstract(argv, 0, &jwlr_at_animator);
+    node = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        property = jl_get_key_def(argv, 2, animation_property_defs);
+    }
+
+    while ((animation = jwlr_animator_find(animator, node, property))) {
+        jwlr_animation_finish(animation, 0);
+        cancelled++;
+    }
+    return janet_wrap_integer(cancelled);
+}
+
+
+static Janet cfun_wlr_animator_tick(int32_t argc, Janet *argv)
+{
+    jwlr_animator_t *animator;
+
+    janet_fixarity(argc, 1);
+
+    animator = janet_getabstract(argv, 0, &jwlr_at_animator);
+    jwlr_animator_tick(animator);
+    return janet_wrap_boolean(!wl_list_empty(&animator->animations));
+}
+
+
+static Janet cfun_wlr_scene_node_destroy(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+
+    janet_fixarity(argc, 1);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    wlr_scene_node_destroy(node);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_node_set_enabled(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+    bool enabled;
+
+    janet_fixarity(argc, 2);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    enabled = janet_getboolean(argv, 1);
+    wlr_scene_node_set_enabled(node, enabled);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_node_place_above(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+    struct wlr_scene_node *sibling;
+
+    janet_fixarity(argc, 2);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    sibling = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+    wlr_scene_node_place_above(node, sibling);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_node_place_below(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+    struct wlr_scene_node *sibling;
+
+    janet_fixarity(argc, 2);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    sibling = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+    wlr_scene_node_place_below(node, sibling);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_node_at(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+    double x, y;
+
+    struct wlr_scene_node *n_node;
+    double nx = 0, ny = 0;
+    Janet ret_tuple[3];
+
+    janet_fixarity(argc, 3);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    x = janet_getnumber(argv, 1);
+    y = janet_getnumber(argv, 2);
+
+    n_node = wlr_scene_node_at(node, x, y, &nx, &ny);
+    if (n_node) {
+        ret_tuple[0] = janet_wrap_abstract(jl_pointer_to_abs_obj(n_node, &jwlr_at_wlr_scene_node));
+    } else {
+        ret_tuple[0] = janet_wrap_nil();
+    }
+    ret_tuple[1] = janet_wrap_number(nx);
+    ret_tuple[2] = janet_wrap_number(ny);
+
+    return janet_wrap_tuple(janet_tuple_n(ret_tuple, 3));
+}
+
+
+static Janet cfun_wlr_scene_node_raise_to_top(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+
+    janet_fixarity(argc, 1);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    wlr_scene_node_raise_to_top(node);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_node_lower_to_bottom(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+
+    janet_fixarity(argc, 1);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    wlr_scene_node_lower_to_bottom(node);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_node_reparent(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+    struct wlr_scene_tree *new_parent;
+
+    janet_fixarity(argc, 2);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    new_parent = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_tree);
+    jwlr_view_index_node_reparent(node, new_parent);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_node_coords(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+
+    int lx, ly;
+    bool ret;
+    Janet ret_tuple[3];
+
+    janet_fixarity(argc, 1);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    ret = wlr_scene_node_coords(node, &lx, &ly);
+    ret_tuple[0] = janet_wrap_boolean(ret);
+    ret_tuple[1] = janet_wrap_integer(lx);
+    ret_tuple[2] = janet_wrap_integer(ly);
+    return janet_wrap_tuple(janet_tuple_n(ret_tuple, 3));
+}
+
+
+static Janet cfun_wlr_scene_node_set_position(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+    int x, y;
+
+    janet_fixarity(argc, 3);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    x = janet_getinteger(argv, 1);
+    y = janet_getinteger(argv, 2);
+
+    wlr_scene_node_set_position(node, x, y);
+    jwlr_view_index_node_moved(node);
+    return janet_wrap_nil();
+}
+
+
+typedef struct {
+    int op;
+    struct wlr_scene_node *node;
+    union {
+        struct {
+            int x;
+            int y;
+        } pos;
+        bool enabled;
+        struct wlr_scene_node *sibling;
+        struct wlr_scene_tree *parent;
+    } arg;
+} jwlr_scene_op_t;
+
+
+static void jwlr_parse_scene_op(Janet op_val, jwlr_scene_op_t *op)
+{
+    const Janet *items;
+    int32_t len;
+    int32_t expected_len;
+
+    if (!janet_indexed_view(op_val, &items, &len) || len < 2) {
+        janet_panicf("expected [op node & args], got %v", op_val);
+    }
+
+    op->op = jl_get_key_def(items, 0, wlr_scene_op_defs);
+    op->node = jl_get_abs_obj_pointer(items, 1, &jwlr_at_wlr_scene_node);
+
+    switch (op->op) {
+    case JWLR_SCENE_OP_SET_POSITION:
+        expected_len = 4;
+        break;
+    case JWLR_SCENE_OP_RAISE_TO_TOP:
+    case JWLR_SCENE_OP_LOWER_TO_BOTTOM:
+        expected_len = 2;
+        break;
+    default:
+        expected_len = 3;
+        break;
+    }
+    if (len != expected_len) {
+        janet_panicf("expected %d elements in scene operation, got %v", expected_len, op_val);
+    }
+
+    switch (op->op) {
+    case JWLR_SCENE_OP_SET_POSITION:
+        op->arg.pos.x = janet_getinteger(items, 2);
+        op->arg.pos.y = janet_getinteger(items, 3);
+        break;
+    case JWLR_SCENE_OP_SET_ENABLED:
+        op->arg.enabled = janet_getboolean(items, 2);
+        break;
+    case JWLR_SCENE_OP_PLACE_ABOVE:
+    case JWLR_SCENE_OP_PLACE_BELOW:
+        op->arg.sibling = jl_get_abs_obj_pointer(items, 2, &jwlr_at_wlr_scene_node);
+        break;
+    case JWLR_SCENE_OP_REPARENT:
+        op->arg.parent = jl_get_abs_obj_pointer(items, 2, &jwlr_at_wlr_scene_tree);
+        break;
+    }
+}
+
+
+/* Parent of node once the first n operations of a batch are applied */
+static struct wlr_scene_tree *jwlr_scene_op_parent_after(const jwlr_scene_op_t *ops, int32_t n,
+                                                         struct wlr_scene_node *node)
+{
+    for (int32_t i = n - 1; i >= 0; i--) {
+        if (JWLR_SCENE_OP_REPARENT == ops[i].op && ops[i].node == node) {
+            return ops[i].arg.parent;
+        }
+    }
+    return node->parent;
+}
+
+
+/* Catches what wlroots would assert on, when the first n operations of a
+   batch are already applied. Pass no ops for a single operation. */
+static void jwlr_scene_op_check(const jwlr_scene_op_t *ops, int32_t n, const jwlr_scene_op_t *op)
+{
+    switch (op->op) {
+    case JWLR_SCENE_OP_PLACE_ABOVE:
+    case JWLR_SCENE_OP_PLACE_BELOW:
+        if (op->node == op->arg.sibling) {
+            janet_panic("can not place a scene node relative to itself");
+        }
+        if (jwlr_scene_op_parent_after(ops, n, op->node) !=
+            jwlr_scene_op_parent_after(ops, n, op->arg.sibling)) {
+            janet_panic("scene node and sibling have different parents");
+        }
+        break;
+    case JWLR_SCENE_OP_REPARENT: {
+        struct wlr_scene_node *ancestor = &op->arg.parent->node;
+        while (ancestor) {
+            if (ancestor == op->node) {
+                janet_panic("can not reparent a scene node under itself or its descendants");
+            }
+            struct wlr_scene_tree *parent = jwlr_scene_op_parent_after(ops, n, ancestor);
+            ancestor = parent ? &parent->node : NULL;
+        }
+        break;
+    }
+    }
+}
+
+
+static Janet cfun_wlr_scene_node_batch(int32_t argc, Janet *argv)
+{
+    JanetView ops_view;
+
+    jwlr_scene_op_t *ops;
+
+    janet_fixarity(argc, 1);
+
+    ops_view = janet_getindexed(argv, 0);
+    if (ops_view.len <= 0) {
+        return janet_wrap_nil();
+    }
+
+    /* Parse and check everything first, so that a malformed operation, or
+       one wlroots would assert on, leaves the scene untouched. Scratch
+       memory is reclaimed by the GC if we panic. */
+    ops = janet_smalloc(sizeof(*ops) * ops_view.len);
+    for (int32_t i = 0; i < ops_view.len; i++) {
+        jwlr_parse_scene_op(ops_view.items[i], &ops[i]);
+        jwlr_scene_op_check(ops, i, &ops[i]);
+    }
+
+    for (int32_t i = 0; i < ops_view.len; i++) {
+        jwlr_scene_op_t *op = &ops[i];
+        switch (op->op) {
+        case JWLR_SCENE_OP_SET_POSITION:
+            wlr_scene_node_set_position(op->node, op->arg.pos.x, op->arg.pos.y);
+            jwlr_view_index_node_moved(op->node);
+            break;
+        case JWLR_SCENE_OP_SET_ENABLED:
+            wlr_scene_node_set_enabled(op->node, op->arg.enabled);
+            break;
+        case JWLR_SCENE_OP_RAISE_TO_TOP:
+            wlr_scene_node_raise_to_top(op->node);
+            break;
+        case JWLR_SCENE_OP_LOWER_TO_BOTTOM:
+            wlr_scene_node_lower_to_bottom(op->node);
+            break;
+        case JWLR_SCENE_OP_PLACE_ABOVE:
+            wlr_scene_node_place_above(op->node, op->arg.sibling);
+            break;
+        case JWLR_SCENE_OP_PLACE_BELOW:
+            wlr_scene_node_place_below(op->node, op->arg.sibling);
+            break;
+        case JWLR_SCENE_OP_REPARENT:
+            jwlr_view_index_node_reparent(op->node, op->arg.parent);
+            break;
+        }
+    }
+
+    janet_sfree(ops);
+    return janet_wrap_nil();
+}
+
+
+static int32_t jwlr_scene_node_count(struct wlr_scene_node *node)
+{
+    int32_t count = 1;
+
+    if (WLR_SCENE_NODE_TREE == node->type) {
+        struct wlr_scene_tree *tree = wl_container_of(node, tree, node);
+        struct wlr_scene_node *child;
+        wl_list_for_each(child, &tree->children, link) {
+            count += jwlr_scene_node_count(child);
+        }
+    }
+
+    return count;
+}
+
+
+typedef struct {
+    JanetArray *nodes;
+    JanetArray *parents;
+    JanetArray *types;
+    JanetArray *xs;
+    JanetArray *ys;
+    JanetArray *enabled;
+    JanetArray *data;
+} jwlr_scene_snapshot_t;
+
+
+static void jwlr_scene_snapshot_node(jwlr_scene_snapshot_t *snapshot,
+                                     struct wlr_scene_node *node,
+                                     int32_t parent_idx)
+{
+    int32_t idx = snapshot->nodes->count;
+
+    if (node->type >= __WLR_SCENE_NODE_TYPE_DEFS_COUNT) {
+        janet_panicf("unknown node type from wlroots scene node: %d", node->type);
+    }
+
+    janet_array_push(snapshot->nodes, janet_wrap_pointer(node));
+    janet_array_push(snapshot->parents, janet_wrap_integer(parent_idx));
+    janet_array_push(snapshot->types, janet_ckeywordv(wlr_scene_node_type_defs[node->type].name));
+    janet_array_push(snapshot->xs, janet_wrap_integer(node->x));
+    janet_array_push(snapshot->ys, janet_wrap_integer(node->y));
+    janet_array_push(snapshot->enabled, janet_wrap_boolean(node->enabled));
+    janet_array_push(snapshot->data, node->data ? janet_wrap_pointer(node->data) : janet_wrap_nil());
+
+    if (WLR_SCENE_NODE_TREE == node->type) {
+        struct wlr_scene_tree *tree = wl_container_of(node, tree, node);
+        struct wlr_scene_node *child;
+        wl_list_for_each(child, &tree->children, link) {
+            jwlr_scene_snapshot_node(snapshot, child, idx);
+        }
+    }
+}
+
+
+static Janet cfun_wlr_scene_tree_snapshot(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_tree *tree;
+
+    int32_t count;
+    jwlr_scene_snapshot_t snapshot;
+    JanetKV *ret;
+
+    janet_fixarity(argc, 1);
+
+    tree = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_tree);
+
+    /* Count the nodes first, so that every array is allocated only once */
+    count = jwlr_scene_node_count(&tree->node);
+    snapshot.nodes = janet_array(count);
+    snapshot.parents = janet_array(count);
+    snapshot.types = janet_array(count);
+    snapshot.xs = janet_array(count);
+    snapshot.ys = janet_array(count);
+    snapshot.enabled = janet_array(count);
+    snapshot.data = janet_array(count);
+
+    jwlr_scene_snapshot_node(&snapshot, &tree->node, -1);
+
+    ret = janet_struct_begin(7);
+    janet_struct_put(ret, janet_ckeywordv("nodes"), janet_wrap_array(snapshot.nodes));
+    janet_struct_put(ret, janet_ckeywordv("parents"), janet_wrap_array(snapshot.parents));
+    janet_struct_put(ret, janet_ckeywordv("types"), janet_wrap_array(snapshot.types));
+    janet_struct_put(ret, janet_ckeywordv("x"), janet_wrap_array(snapshot.xs));
+    janet_struct_put(ret, janet_ckeywordv("y"), janet_wrap_array(snapshot.ys));
+    janet_struct_put(ret, janet_ckeywordv("enabled"), janet_wrap_array(snapshot.enabled));
+    janet_struct_put(ret, janet_ckeywordv("data"), janet_wrap_array(snapshot.data));
+    return janet_wrap_struct(janet_struct_end(ret));
+}
+
+
+static Janet cfun_wlr_scene_node_find_ancestor_data(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+    const JanetAbstractType *data_at = NULL;
+    int data_is_table = 0;
+
+    struct wlr_scene_tree *tree;
+    Janet ret_tuple[2];
+
+    janet_arity(argc, 1, 2);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    if (argc > 1) {
+        switch (janet_type(argv[1])) {
+        case JANET_NIL:
+            break;
+        case JANET_KEYWORD:
+            if (janet_cstrcmp(janet_unwrap_keyword(argv[1]), "table")) {
+                janet_panicf("unknown data type: %v", argv[1]);
+            }
+            data_is_table = 1;
+            break;
+        case JANET_SYMBOL:
+            data_at = jl_get_abstract_type_by_key(argv[1]);
+            break;
+        default:
+            janet_panicf("bad slot #1: expected nil, :table or abstract type name, got %v", argv[1]);
+        }
+    }
+
+    for (tree = node->parent; tree; tree = tree->node.parent) {
+        if (tree->node.data) {
+            break;
+        }
+    }
+    if (!tree) {
+        return janet_wrap_nil();
+    }
+
+    ret_tuple[0] = janet_wrap_abstract(jl_pointer_to_abs_obj(tree, &jwlr_at_wlr_scene_tree));
+    if (data_is_table) {
+        ret_tuple[1] = janet_wrap_table((JanetTable *)tree->node.data);
+    } else if (data_at) {
+        ret_tuple[1] = janet_wrap_abstract(jl_pointer_to_abs_obj(tree->node.data, data_at));
+    } else {
+        ret_tuple[1] = janet_wrap_pointer(tree->node.data);
+    }
+    return janet_wrap_tuple(janet_tuple_n(ret_tuple, 2));
+}
+
+
+static Janet cfun_wlr_view_index_create(int32_t argc, Janet *argv)
+{
+    int32_t cell_size;
+
+    jwlr_view_index_t *index;
+
+    janet_arity(argc, 0, 1);
+
+    cell_size = janet_optnat(argv, argc, 0, JWLR_VIEW_INDEX_DEFAULT_CELL_SIZE);
+    if (cell_size <= 0) {
+        janet_panicf("invalid cell size: %d", cell_size);
+    }
+
+    index = janet_abstract(&jwlr_at_view_index, sizeof(*index));
+    memset(index, 0, sizeof(*index));
+    index->cell_size = cell_size;
+    wl_list_init(&index->entries);
+    return janet_wrap_abstract(index);
+}
+
+
+static Janet cfun_wlr_view_index_add(int32_t argc, Janet *argv)
+{
+    jwlr_view_index_t *index;
+    struct wlr_scene_node *node;
+    Janet value;
+    int width, height;
+
+    jwlr_view_index_entry_t *entry;
+
+    janet_fixarity(argc, 5);
+
+    index = janet_getabstract(argv, 0, &jwlr_at_view_index);
+    node = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+    value = argv[2];
+    width = janet_getinteger(argv, 3);
+    height = janet_getinteger(argv, 4);
+
+    entry = jwlr_view_index_find_entry(index, node);
+    if (!entry) {
+        entry = malloc(sizeof(*entry));
+        if (!entry) {
+            JANET_OUT_OF_MEMORY;
+        }
+        memset(entry, 0, sizeof(*entry));
+        entry->index = index;
+        entry->node = node;
+        entry->destroy.notify = jwlr_view_index_entry_handle_destroy;
+        wl_signal_add(&node->events.destroy, &entry->destroy);
+        jwlr_view_index_subtree_adjust(node, 1);
+        jwlr_view_index_entry_count++;
+        wl_list_insert(&index->entries, &entry->link);
+    }
+    entry->value = value;
+    entry->width = width;
+    entry->height = height;
+    jwlr_view_index_entry_update(entry);
+
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_view_index_set_size(int32_t argc, Janet *argv)
+{
+    jwlr_view_index_t *index;
+    struct wlr_scene_node *node;
+    int width, height;
+
+    jwlr_view_index_entry_t *entry;
+
+    janet_fixarity(argc, 4);
+
+    index = janet_getabstract(argv, 0, &jwlr_at_view_index);
+    node = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+    width = janet_getinteger(argv, 2);
+    height = janet_getinteger(argv, 3);
+
+    entry = jwlr_view_index_find_entry(index, node);
+    if (!entry) {
+        janet_panic("node not found in view index");
+    }
+    entry->width = width;
+    entry->height = height;
+    jwlr_view_index_entry_update(entry);
+
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_view_index_update(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_node *node;
+
+    janet_fixarity(argc, 1);
+
+    node = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_node);
+    jwlr_view_index_node_moved(node);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_view_index_remove(int32_t argc, Janet *argv)
+{
+    jwlr_view_index_t *index;
+    struct wlr_scene_node *node;
+
+    jwlr_view_index_entry_t *entry;
+
+    janet_fixarity(argc, 2);
+
+    index = janet_getabstract(argv, 0, &jwlr_at_view_index);
+    node = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+
+    entry = jwlr_view_index_find_entry(index, node);
+    if (!entry) {
+        return janet_wrap_false();
+    }
+    jwlr_view_index_entry_free(entry);
+    return janet_wrap_true();
+}
+
+
+static Janet cfun_wlr_view_index_at(int32_t argc, Janet *argv)
+{
+    jwlr_view_index_t *index;
+    double lx, ly;
+
+    jwlr_view_index_bucket_t *bucket;
+    jwlr_view_index_entry_t **candidates;
+    int32_t candidate_count = 0;
+    int32_t cx, cy;
+    Janet ret = janet_wrap_nil();
+
+    janet_fixarity(argc, 3);
+
+    index = janet_getabstract(argv, 0, &jwlr_at_view_index);
+    lx = janet_getnumber(argv, 1);
+    ly = janet_getnumber(argv, 2);
+
+    cx = jwlr_view_index_cell_coord((int)floor(lx), index->cell_size);
+    cy = jwlr_view_index_cell_coord((int)floor(ly), index->cell_size);
+    bucket = jwlr_view_index_get_bucket(index, cx, cy);
+    if (bucket->count <= 0) {
+        return ret;
+    }
+
+    candidates = janet_smalloc(sizeof(*candidates) * bucket->count);
+    for (int32_t i = 0; i < bucket->count; i++) {
+        jwlr_view_index_cell_ref_t *ref = &bucket->refs[i];
+        jwlr_view_index_entry_t *entry = ref->entry;
+        if (ref->cx == cx && ref->cy == cy &&
+            wlr_box_contains_point(&entry->box, lx, ly) &&
+            jwlr_scene_node_enabled_in_tree(entry->node)) {
+            candidates[candidate_count++] = entry;
+        }
+    }
+
+    /* Try the candidates from top to bottom. The bounding boxes are only
+       approximations, so check the actual content of the view too. */
+    while (candidate_count > 0) {
+        int32_t top = 0;
+        for (int32_t i = 1; i < candidate_count; i++) {
+            if (jwlr_scene_node_is_above(candidates[i]->node, candidates[top]->node)) {
+                top = i;
+            }
+        }
+
+        jwlr_view_index_entry_t *entry = candidates[top];
+        double nx = 0, ny = 0;
+        struct wlr_scene_node *n_node = wlr_scene_node_at(entry->node, lx, ly, &nx, &ny);
+        if (n_node) {
+            Janet ret_tuple[4];
+            ret_tuple[0] = entry->value;
+            ret_tuple[1] = janet_wrap_abstract(jl_pointer_to_abs_obj(n_node, &jwlr_at_wlr_scene_node));
+            ret_tuple[2] = janet_wrap_number(nx);
+            ret_tuple[3] = janet_wrap_number(ny);
+            ret = janet_wrap_tuple(janet_tuple_n(ret_tuple, 4));
+            break;
+        }
+
+        candidates[top] = candidates[--candidate_count];
+    }
+
+    janet_sfree(candidates);
+    return ret;
+}
+
+
+/* A workspace is a scene tree whose children are views. Hiding or showing
+   all of its views only needs to flip the tree's enabled state. Disabled
+   trees are skipped by wlr_scene_output_send_frame_done(), so clients on
+   hidden workspaces get their frame callbacks from
+   wlr-workspace-send-frame-done instead, at a reduced rate. */
+typedef struct {
+    struct wlr_scene_tree *tree;
+    struct wl_listener tree_destroy;
+    struct wl_list members;
+    int32_t member_count;
+    int32_t hidden_frame_interval_ms;
+    struct timespec last_hidden_frame;
+} jwlr_workspace_t;
+
+typedef struct {
+    jwlr_workspace_t *workspace;
+    struct wlr_scene_node *node;
+    struct wl_listener destroy;
+    struct wl_list link;
+    Janet value;
+} jwlr_workspace_member_t;
+
+
+static void jwlr_workspace_member_free(jwlr_workspace_member_t *member)
+{
+    wl_list_remove(&member->destroy.link);
+    wl_list_remove(&member->link);
+    member->workspace->member_count--;
+    free(member);
+}
+
+
+static void jwlr_workspace_member_handle_destroy(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_workspace_member_t *member = wl_container_of(listener, member, destroy);
+    jwlr_workspace_member_free(member);
+}
+
+
+static void jwlr_workspace_handle_tree_destroy(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_workspace_t *workspace = wl_container_of(listener, workspace, tree_destroy);
+    /* Members are freed by their own destroy listeners, when the children
+       of this tree get destroyed. */
+    wl_list_remove(&workspace->tree_destroy.link);
+    wl_list_init(&workspace->tree_destroy.link);
+    workspace->tree = NULL;
+}
+
+
+static jwlr_workspace_member_t *jwlr_workspace_find_member(jwlr_workspace_t *workspace,
+                                                           struct wlr_scene_node *node)
+{
+    jwlr_workspace_member_t *member;
+    wl_list_for_each(member, &workspace->members, link) {
+        if (member->node == node) {
+            return member;
+        }
+    }
+    return NULL;
+}
+
+
+/* A node can only be in one workspace, find out which one through the
+   node's destroy listeners */
+static jwlr_workspace_member_t *jwlr_workspace_find_node_member(struct wlr_scene_node *node)
+{
+    struct wl_listener *listener;
+    wl_list_for_each(listener, &node->events.destroy.listener_list, link) {
+        if (listener->notify == jwlr_workspace_member_handle_destroy) {
+            jwlr_workspace_member_t *member = wl_container_of(listener, member, destroy);
+            return member;
+        }
+    }
+    return NULL;
+}
+
+
+static int method_workspace_gc(void *p, size_t len)
+{
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    jwlr_workspace_t *workspace = (jwlr_workspace_t *)p;
+    jwlr_workspace_member_t *member, *tmp;
+
+    wl_list_for_each_safe(member, tmp, &workspace->members, link) {
+        jwlr_workspace_member_free(member);
+    }
+    wl_list_remove(&workspace->tree_destroy.link);
+
+    return 0;
+}
+
+
+static int method_workspace_gcmark(void *p, size_t len)
+{
+    (void)len;
+    jwlr_workspace_t *workspace = (jwlr_workspace_t *)p;
+    jwlr_workspace_member_t *member;
+
+    wl_list_for_each(member, &workspace->members, link) {
+        janet_mark(member->value);
+    }
+
+    return 0;
+}
+
+
+static jwlr_workspace_t *jwlr_get_workspace(const Janet *argv, int32_t n)
+{
+    jwlr_workspace_t *workspace = janet_getabstract(argv, n, &jwlr_at_workspace);
+    if (!(workspace->tree)) {
+        janet_panicf("workspace %v is already destroyed", argv[n]);
+    }
+    return workspace;
+}
+
+
+static int method_workspace_get(void *p, Janet key, Janet *out)
+{
+    jwlr_workspace_t *workspace = (jwlr_workspace_t *)p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "tree")) {
+        if (!(workspace->tree)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(workspace->tree, &jwlr_at_wlr_scene_tree));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "visible")) {
+        *out = janet_wrap_boolean(workspace->tree && workspace->tree->node.enabled);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "view-count")) {
+        *out = janet_wrap_integer(workspace->member_count);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "views")) {
+        JanetArray *arr = janet_array(workspace->member_count);
+        jwlr_workspace_member_t *member;
+        if (workspace->tree) {
+            /* Bottom to top, as stacked in the scene */
+            struct wlr_scene_node *child;
+            wl_list_for_each(child, &workspace->tree->children, link) {
+                member = jwlr_workspace_find_node_member(child);
+                if (member && member->workspace == workspace) {
+                    janet_array_push(arr, member->value);
+                }
+            }
+        }
+        /* Views reparented out of the workspace tree stay members until
+           removed, list them last, in the order they were added */
+        wl_list_for_each_reverse(member, &workspace->members, link) {
+            if (!(workspace->tree) || member->node->parent != workspace->tree) {
+                janet_array_push(arr, member->value);
+            }
+        }
+        *out = janet_wrap_array(arr);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "hidden-frame-interval")) {
+        *out = janet_wrap_integer(workspace->hidden_frame_interval_ms);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static Janet cfun_wlr_workspace_create(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_tree *parent;
+    int32_t hidden_frame_interval_ms;
+
+    jwlr_workspace_t *workspace;
+
+    janet_arity(argc, 1, 2);
+
+    parent = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_tree);
+    hidden_frame_interval_ms = janet_optnat(argv, argc, 1, 1000);
+
+    workspace = janet_abstract(&jwlr_at_workspace, sizeof(*workspace));
+    memset(workspace, 0, sizeof(*workspace));
+    wl_list_init(&workspace->members);
+    wl_list_init(&workspace->tree_destroy.link);
+    workspace->hidden_frame_interval_ms = hidden_frame_interval_ms;
+
+    workspace->tree = wlr_scene_tree_create(parent);
+    if (!(workspace->tree)) {
+        janet_panic("failed to create wlroots scene tree object");
+    }
+    wlr_scene_node_set_enabled(&workspace->tree->node, false);
+    workspace->tree_destroy.notify = jwlr_workspace_handle_tree_destroy;
+    wl_signal_add(&workspace->tree->node.events.destroy, &workspace->tree_destroy);
+
+    return janet_wrap_abstract(workspace);
+}
+
+
+static Janet cfun_wlr_workspace_destroy(int32_t argc, Janet *argv)
+{
+    jwlr_workspace_t *workspace;
+
+    janet_fixarity(argc, 1);
+
+    workspace = janet_getabstract(argv, 0, &jwlr_at_workspace);
+    if (workspace->tree) {
+        wlr_scene_node_destroy(&workspace->tree->node);
+    }
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_workspace_add_view(int32_t argc, Janet *argv)
+{
+    jwlr_workspace_t *workspace;
+    struct wlr_scene_node *node;
+
+    jwlr_workspace_member_t *member;
+
+    janet_fixarity(argc, 3);
+
+    workspace = jwlr_get_workspace(argv, 0);
+    node = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+
+    member = jwlr_workspace_find_node_member(node);
+    if (member && member->workspace != workspace) {
+        /* Moving to another workspace */
+        jwlr_workspace_member_free(member);
+        member = NULL;
+    }
+    if (!member) {
+        member = malloc(sizeof(*member));
+        if (!member) {
+            JANET_OUT_OF_MEMORY;
+        }
+        member->workspace = workspace;
+        member->node = node;
+        member->destroy.notify = jwlr_workspace_member_handle_destroy;
+        wl_signal_add(&node->events.destroy, &member->destroy);
+        wl_list_insert(&workspace->members, &member->link);
+        workspace->member_count++;
+    }
+    member->value = argv[2];
+
+    jwlr_view_index_node_reparent(node, workspace->tree);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_workspace_remove_view(int32_t argc, Janet *argv)
+{
+    jwlr_workspace_t *workspace;
+    struct wlr_scene_node *node;
+
+    jwlr_workspace_member_t *member;
+
+    janet_fixarity(argc, 2);
+
+    workspace = janet_getabstract(argv, 0, &jwlr_at_workspace);
+    node = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_scene_node);
+
+    member = jwlr_workspace_find_member(workspace, node);
+    if (!member) {
+        return janet_wrap_false();
+    }
+    jwlr_workspace_member_free(member);
+    return janet_wrap_true();
+}
+
+
+static Janet cfun_wlr_workspace_switch(int32_t argc, Janet *argv)
+{
+    jwlr_workspace_t *from = NULL;
+    jwlr_workspace_t *to;
+
+    janet_fixarity(argc, 2);
+
+    if (!janet_checktype(argv[0], JANET_NIL)) {
+        from = jwlr_get_workspace(argv, 0);
+    }
+    to = jwlr_get_workspace(argv, 1);
+
+    if (from && from != to) {
+        wlr_scene_node_set_enabled(&from->tree->node, false);
+    }
+    wlr_scene_node_set_enabled(&to->tree->node, true);
+    return janet_wrap_nil();
+}
+
+
+static void jwlr_send_frame_done_in_tree(struct wlr_scene_node *node, struct timespec *now)
+{
+    /* Ignore the enabled state, all clients in the tree are throttled alike */
+    if (WLR_SCENE_NODE_BUFFER == node->type) {
+        wlr_scene_buffer_send_frame_done(wlr_scene_buffer_from_node(node), now);
+    } else if (WLR_SCENE_NODE_TREE == node->type) {
+        struct wlr_scene_tree *tree = wl_container_of(node, tree, node);
+        struct wlr_scene_node *child;
+        wl_list_for_each(child, &tree->children, link) {
+            jwlr_send_frame_done_in_tree(child, now);
+        }
+    }
+}
+
+
+static Janet cfun_wlr_workspace_send_frame_done(int32_t argc, Janet *argv)
+{
+    jwlr_workspace_t *workspace;
+    struct timespec *now;
+
+    int64_t elapsed_ms;
+
+    janet_fixarity(argc, 2);
+
+    workspace = jwlr_get_workspace(argv, 0);
+    now = janet_getabstract(argv, 1, jl_get_abstract_type_by_name(UTIL_MOD_NAME "/timespec"));
+
+    if (workspace->tree->node.enabled) {
+        /* Visible workspaces are handled by wlr-scene-output-send-frame-done */
+        return janet_wrap_false();
+    }
+
+    elapsed_ms = (int64_t)(now->tv_sec - workspace->last_hidden_frame.tv_sec) * 1000 +
+        (now->tv_nsec - workspace->last_hidden_frame.tv_nsec) / 1000000;
+    if (elapsed_ms < workspace->hidden_frame_interval_ms) {
+        return janet_wrap_false();
+    }
+
+    workspace->last_hidden_frame = *now;
+    jwlr_send_frame_done_in_tree(&workspace->tree->node, now);
+    return janet_wrap_true();
+}
+
+
+static int method_wlr_scene_tree_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_scene_tree **tree_p = (struct wlr_scene_tree **)p;
+    struct wlr_scene_tree *tree = *tree_p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    struct wl_list **list_p = get_abstract_struct_list_member(tree, kw, wlr_scene_tree_list_offsets);
+    if (list_p) {
+        *out = janet_wrap_abstract(list_p);
+        return 1;
+    }
+
+    if (!janet_cstrcmp(kw, "node")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&tree->node, &jwlr_at_wlr_scene_node));
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_scene_node_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_scene_node **node_p = (struct wlr_scene_node **)p;
+    struct wlr_scene_node *node = *node_p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    struct wl_signal **signal_p = get_abstract_struct_signal_member(node, kw, wlr_scene_node_signal_offsets);
+    if (signal_p) {
+        *out = janet_wrap_abstract(signal_p);
+        return 1;
+    }
+
+    if (!janet_cstrcmp(kw, "type")) {
+        if (node->type >= __WLR_SCENE_NODE_TYPE_DEFS_COUNT) {
+            janet_panicf("unknown node type from wlroots scene node: %d", node->type);
+        }
+        *out = janet_ckeywordv(wlr_scene_node_type_defs[node->type].name);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "parent")) {
+        if (!(node->parent)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(node->parent, &jwlr_at_wlr_scene_tree));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "enabled")) {
+        *out = janet_wrap_boolean(node->enabled);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "x")) {
+        *out = janet_wrap_integer(node->x);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "y")) {
+        *out = janet_wrap_integer(node->y);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "data")) {
+        if (!(node->data)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_pointer(node->data);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void method_wlr_scene_node_put(void *p, Janet key, Janet value) {
+    struct wlr_scene_node **node_p = (struct wlr_scene_node **)p;
+    struct wlr_scene_node *node = *node_p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "data")) {
+        node->data = jl_value_to_data_pointer(value);
+        return;
+    }
+
+    janet_panicf("unknown key: %v", key);
+}
+
+
+static int method_wlr_scene_rect_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_scene_rect **rect_p = (struct wlr_scene_rect **)p;
+    struct wlr_scene_rect *rect = *rect_p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "node")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&rect->node, &jwlr_at_wlr_scene_node));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "width")) {
+        *out = janet_wrap_integer(rect->width);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "height")) {
+        *out = janet_wrap_integer(rect->height);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "color")) {
+        Janet color[4];
+        for (int i = 0; i < 4; i++) {
+            color[i] = janet_wrap_number(rect->color[i]);
+        }
+        *out = janet_wrap_tuple(janet_tuple_n(color, 4));
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_input_device_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_input_device **device_p = (struct wlr_input_device **)p;
+    struct wlr_input_device *device = *device_p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    struct wl_signal **signal_p = get_abstract_struct_signal_member(device, kw, wlr_input_device_signal_offsets);
+    if (signal_p) {
+        *out = janet_wrap_abstract(signal_p);
+        return 1;
+    }
+
+    if (!janet_cstrcmp(kw, "type")) {
+        if (device->type >= __WLR_INPUT_DEVICE_DEFS_COUNT) {
+            janet_panicf("unknown device type from wlroots input device: %d", device->type);
+        }
+        *out = janet_ckeywordv(wlr_input_device_defs[device->type].name);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "vendor")) {
+        /* XXX: unsigned int -> int32_t conversion */
+        *out = janet_wrap_integer(device->vendor);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "product")) {
+        /* XXX: unsigned int -> int32_t conversion */
+        *out = janet_wrap_integer(device->product);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "name")) {
+        if (!(device->name)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_cstringv(device->name);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "data")) {
+        if (!(device->data)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_pointer(device->data);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_pointer_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_pointer **pointer_p = (struct wlr_pointer **)p;
+    struct wlr_pointer *pointer = *pointer_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    struct wl_signal **signal_p = get_abstract_struct_signal_member(pointer, kw, wlr_pointer_signal_offsets);
+    if (signal_p) {
+        *out = janet_wrap_abstract(signal_p);
+        return 1;
+    }
+
+    if (!janet_cstrcmp(kw, "base")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&pointer->base, &jwlr_at_wlr_input_device));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "output-name")) {
+        *out = janet_cstringv(pointer->output_name);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "data")) {
+        if (!(pointer->data)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_pointer(pointer->data);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_keyboard_modifiers_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_keyboard_modifiers **modifiers_p = (struct wlr_keyboard_modifiers **)p;
+    struct wlr_keyboard_modifiers *modifiers = *modifiers_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+    xkb_mod_mask_t *member_p;
+
+    if (!janet_cstrcmp(kw, "depressed")) {
+        member_p = &modifiers->depressed;
+    } else if (!janet_cstrcmp(kw, "latched")) {
+        member_p = &modifiers->latched;
+    } else if (!janet_cstrcmp(kw, "locked")) {
+        member_p = &modifiers->locked;
+    } else if (!janet_cstrcmp(kw, "group")) {
+        member_p = &modifiers->group;
+    } else {
+        return 0;
+    }
+
+    *out = janet_wrap_array(jl_get_flag_keys(*member_p, wlr_keyboard_modifier_defs));
+    return 1;
+}
+
+
+/* Fixed-size input event records, used by virtual input devices and the
+   input recorder/replayer. The meaning of the fields depends on type. */
+typedef struct {
+    uint64_t time_nsec;
+    uint32_t type;
+    uint32_t code;      /* button, keycode or axis orientation */
+    uint32_t state;     /* button or key state, or axis source */
+    int32_t discrete;
+    double a;           /* dx, x or axis delta */
+    double b;           /* dy or y */
+} jwlr_input_record_t;
+
+
+/* Virtual input devices, for driving the input paths without real
+   hardware. They get announced through the backend's new_input signal, and
+   stay alive until wlr-virtual-input-destroy is called. The Janet objects
+   are rooted until then, since finishing a device from the GC would fire
+   destroy listeners in the middle of a sweep. */
+typedef struct {
+    enum wlr_input_device_type type;
+    union {
+        struct wlr_keyboard keyboard;
+        struct wlr_pointer pointer;
+    };
+} jwlr_virtual_input_t;
+
+typedef struct {
+    jwlr_virtual_input_t *input;
+} jwlr_virtual_input_obj_t;
+
+static const struct wlr_keyboard_impl jwlr_virtual_keyboard_impl = {
+    .name = "janetland-virtual-keyboard",
+};
+
+static const struct wlr_pointer_impl jwlr_virtual_pointer_impl = {
+    .name = "janetland-virtual-pointer",
+};
+
+
+static void jwlr_virtual_input_obj_drop(jwlr_virtual_input_obj_t *obj)
+{
+    jwlr_virtual_input_t *input = obj->input;
+
+    if (!input) {
+        return;
+    }
+    obj->input = NULL;
+    /* Emits the input device's destroy signal */
+    if (WLR_INPUT_DEVICE_KEYBOARD == input->type) {
+        wlr_keyboard_finish(&input->keyboard);
+    } else {
+        wlr_pointer_finish(&input->pointer);
+    }
+    free(input);
+}
+
+
+static int method_virtual_input_gc(void *p, size_t len)
+{
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    /* Rooted until wlr-virtual-input-destroy, so the device is already gone,
+       unless Janet itself is shutting down */
+    return 0;
+}
+
+
+static int method_virtual_input_get(void *p, Janet key, Janet *out)
+{
+    jwlr_virtual_input_obj_t *obj = (jwlr_virtual_input_obj_t *)p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!obj->input) {
+        return 0;
+    }
+    if (!janet_cstrcmp(kw, "base")) {
+        struct wlr_input_device *base = WLR_INPUT_DEVICE_KEYBOARD == obj->input->type ?
+            &obj->input->keyboard.base : &obj->input->pointer.base;
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(base, &jwlr_at_wlr_input_device));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "keyboard") && WLR_INPUT_DEVICE_KEYBOARD == obj->input->type) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&obj->input->keyboard, &jwlr_at_wlr_keyboard));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "pointer") && WLR_INPUT_DEVICE_POINTER == obj->input->type) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&obj->input->pointer, &jwlr_at_wlr_pointer));
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static jwlr_virtual_input_t *jwlr_get_virtual_input(const Janet *argv, int32_t n)
+{
+    jwlr_virtual_input_obj_t *obj = janet_getabstract(argv, n, &jwlr_at_virtual_input);
+    if (!(obj->input)) {
+        janet_panicf("virtual input %v is already destroyed", argv[n]);
+    }
+    return obj->input;
+}
+
+
+static Janet jwlr_virtual_input_create(int32_t argc, Janet *argv, enum wlr_input_device_type type)
+{
+    struct wlr_backend *backend;
+    const char *name;
+
+    jwlr_virtual_input_t *input;
+    jwlr_virtual_input_obj_t *obj;
+    struct wlr_input_device *base;
+
+    janet_arity(argc, 1, 2);
+
+    backend = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_backend);
+    name = janet_optcstring(argv, argc, 1,
+                            WLR_INPUT_DEVICE_KEYBOARD == type ?
+                            jwlr_virtual_keyboard_impl.name : jwlr_virtual_pointer_impl.name);
+
+    input = calloc(1, sizeof(*input));
+    if (!input) {
+        JANET_OUT_OF_MEMORY;
+    }
+    input->type = type;
+    if (WLR_INPUT_DEVICE_KEYBOARD == type) {
+        wlr_keyboard_init(&input->keyboard, &jwlr_virtual_keyboard_impl, name);
+        base = &input->keyboard.base;
+    } else {
+        wlr_pointer_init(&input->pointer, &jwlr_virtual_pointer_impl, name);
+        base = &input->pointer.base;
+    }
+
+    obj = janet_abstract(&jwlr_at_virtual_input, sizeof(*obj));
+    obj->input = input;
+    janet_gcroot(janet_wrap_abstract(obj));
+
+    wl_signal_emit(&backend->events.new_input, base);
+    return janet_wrap_abstract(obj);
+}
+
+
+static uint32_t jwlr_virtual_input_time_msec(const Janet *argv, int32_t argc, int32_t n)
+{
+    if (argc > n && !janet_checktype(argv[n], JANET_NIL)) {
+        return (uint32_t)janet_getuinteger64(argv, n);
+    } else {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    }
+}
+
+
+/* Emits the event in rec, returns -1 if it doesn't fit the device type.
+   Called from event loop callbacks, so it must not panic. */
+static int jwlr_input_record_emit(jwlr_virtual_input_t *input,
+                                  const jwlr_input_record_t *rec,
+                                  uint32_t time_msec)
+{
+    struct wlr_pointer *pointer = &input->pointer;
+
+    if (JWLR_VIRTUAL_EVENT_KEY == rec->type) {
+        if (WLR_INPUT_DEVICE_KEYBOARD != input->type) {
+            return -1;
+        }
+    } else if (WLR_INPUT_DEVICE_POINTER != input->type) {
+        return -1;
+    }
+
+    switch (rec->type) {
+    case JWLR_VIRTUAL_EVENT_MOTION: {
+        struct wlr_pointer_motion_event event = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .delta_x = rec->a,
+            .delta_y = rec->b,
+            .unaccel_dx = rec->a,
+            .unaccel_dy = rec->b,
+        };
+        wl_signal_emit(&pointer->events.motion, &event);
+        break;
+    }
+    case JWLR_VIRTUAL_EVENT_MOTION_ABSOLUTE: {
+        struct wlr_pointer_motion_absolute_event event = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .x = rec->a,
+            .y = rec->b,
+        };
+        wl_signal_emit(&pointer->events.motion_absolute, &event);
+        break;
+    }
+    case JWLR_VIRTUAL_EVENT_BUTTON: {
+        struct wlr_pointer_button_event event = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .button = rec->code,
+            .state = rec->state,
+        };
+        wl_signal_emit(&pointer->events.button, &event);
+        break;
+    }
+    case JWLR_VIRTUAL_EVENT_AXIS: {
+        struct wlr_pointer_axis_event event = {
+            .pointer = pointer,
+            .time_msec = time_msec,
+            .orientation = rec->code,
+            .source = rec->state,
+            .delta = rec->a,
+            .delta_discrete = rec->discrete,
+        };
+        wl_signal_emit(&pointer->events.axis, &event);
+        break;
+    }
+    case JWLR_VIRTUAL_EVENT_FRAME:
+        wl_signal_emit(&pointer->events.frame, pointer);
+        break;
+    case JWLR_VIRTUAL_EVENT_KEY: {
+        struct wlr_keyboard_key_event event = {
+            .time_msec = time_msec,
+            .keycode = rec->code,
+            .update_state = true,
+            .state = rec->state,
+        };
+        wlr_keyboard_notify_key(&input->keyboard, &event);
+        break;
+    }
+    default:
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Emits one event described by argv, e.g. [:motion dx dy &opt time-msec] */
+static void jwlr_virtual_input_emit(jwlr_virtual_input_t *input, int32_t argc, const Janet *argv)
+{
+    jwlr_input_record_t rec;
+    uint32_t time_msec;
+
+    if (argc < 1) {
+        janet_panic("empty virtual input event");
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    rec.type = jl_get_key_def(argv, 0, virtual_input_event_defs);
+
+    switch (rec.type) {
+    case JWLR_VIRTUAL_EVENT_MOTION:
+    case JWLR_VIRTUAL_EVENT_MOTION_ABSOLUTE:
+        janet_arity(argc, 3, 4);
+        rec.a = janet_getnumber(argv, 1);
+        rec.b = janet_getnumber(argv, 2);
+        time_msec = jwlr_virtual_input_time_msec(argv, argc, 3);
+        break;
+    case JWLR_VIRTUAL_EVENT_BUTTON:
+        janet_arity(argc, 3, 4);
+        rec.code = (uint32_t)janet_getuinteger64(argv, 1);
+        rec.state = jl_get_key_def(argv, 2, wlr_button_state_defs);
+        time_msec = jwlr_virtual_input_time_msec(argv, argc, 3);
+        break;
+    case JWLR_VIRTUAL_EVENT_AXIS:
+        janet_arity(argc, 3, 6);
+        rec.code = jl_get_key_def(argv, 1, wlr_axis_orientation_defs);
+        rec.a = janet_getnumber(argv, 2);
+        rec.discrete = janet_optinteger(argv, argc, 3, 0);
+        if (argc > 4 && !janet_checktype(argv[4], JANET_NIL)) {
+            rec.state = jl_get_key_def(argv, 4, wlr_axis_source_defs);
+        } else {
+            rec.state = WLR_AXIS_SOURCE_WHEEL;
+        }
+        time_msec = jwlr_virtual_input_time_msec(argv, argc, 5);
+        break;
+    case JWLR_VIRTUAL_EVENT_FRAME:
+        janet_fixarity(argc, 1);
+        time_msec = 0;
+        break;
+    case JWLR_VIRTUAL_EVENT_KEY:
+        janet_arity(argc, 3, 4);
+        rec.code = (uint32_t)janet_getuinteger64(argv, 1);
+        rec.state = jl_get_key_def(argv, 2, wl_keyboard_key_state_defs);
+        time_msec = jwlr_virtual_input_time_msec(argv, argc, 3);
+        break;
+    default:
+        janet_panicf("unsupported virtual input event: %v", argv[0]);
+    }
+
+    if (jwlr_input_record_emit(input, &rec, time_msec) < 0) {
+        janet_panicf("event %v is not supported by %s",
+                     argv[0],
+                     WLR_INPUT_DEVICE_KEYBOARD == input->type ? "virtual keyboards" : "virtual pointers");
+    }
+}
+
+
+static Janet cfun_wlr_virtual_keyboard_create(int32_t argc, Janet *argv)
+{
+    return jwlr_virtual_input_create(argc, argv, WLR_INPUT_DEVICE_KEYBOARD);
+}
+
+
+static Janet cfun_wlr_virtual_pointer_create(int32_t argc, Janet *argv)
+{
+    return jwlr_virtual_input_create(argc, argv, WLR_INPUT_DEVICE_POINTER);
+}
+
+
+static Janet cfun_wlr_virtual_input_destroy(int32_t argc, Janet *argv)
+{
+    jwlr_virtual_input_obj_t *obj;
+
+    janet_fixarity(argc, 1);
+
+    obj = janet_getabstract(argv, 0, &jwlr_at_virtual_input);
+    if (obj->input) {
+        jwlr_virtual_input_obj_drop(obj);
+        janet_gcunroot(janet_wrap_abstract(obj));
+    }
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_virtual_input_emit(int32_t argc, Janet *argv)
+{
+    jwlr_virtual_input_t *input;
+
+    janet_arity(argc, 2, -1);
+
+    input = jwlr_get_virtual_input(argv, 0);
+    jwlr_virtual_input_emit(input, argc - 1, argv + 1);
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_virtual_input_emit_batch(int32_t argc, Janet *argv)
+{
+    jwlr_virtual_input_t *input;
+    JanetView events;
+
+    janet_fixarity(argc, 2);
+
+    input = jwlr_get_virtual_input(argv, 0);
+    events = janet_getindexed(argv, 1);
+    for (int32_t i = 0; i < events.len; i++) {
+        JanetView event;
+        if (!janet_indexed_view(events.items[i], &event.items, &event.len)) {
+            janet_panicf("expected an indexed virtual input event, got %v", events.items[i]);
+        }
+        jwlr_virtual_input_emit(input, event.len, event.items);
+    }
+    return janet_wrap_integer(events.len);
+}
+
+
+/* Reads all the Janet forms in the file at path into an array, panics if
+   the file can't be read or parsed */
+static JanetArray *jwlr_read_virtual_input_file(const char *path)
+{
+    JanetParser parser;
+    JanetArray *events = janet_array(0);
+    FILE *f;
+    int c;
+    const char *err = NULL;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        janet_panicf("failed to open %s: %s", path, strerror(errno));
+    }
+
+    janet_parser_init(&parser);
+    while (!err && EOF != (c = fgetc(f))) {
+        janet_parser_consume(&parser, (uint8_t)c);
+        while (janet_parser_has_more(&parser)) {
+            janet_array_push(events, janet_parser_produce(&parser));
+        }
+        err = janet_parser_error(&parser);
+    }
+    if (!err) {
+        janet_parser_eof(&parser);
+        while (janet_parser_has_more(&parser)) {
+            janet_array_push(events, janet_parser_produce(&parser));
+        }
+        err = janet_parser_error(&parser);
+    }
+    fclose(f);
+
+    if (err) {
+        size_t line = parser.line;
+        janet_parser_deinit(&parser);
+        janet_panicf("%s:%d: %s", path, (int32_t)line, err);
+    }
+    janet_parser_deinit(&parser);
+    return events;
+}
+
+
+static Janet cfun_wlr_virtual_input_emit_file(int32_t argc, Janet *argv)
+{
+    jwlr_virtual_input_t *input;
+    const char *path;
+    JanetArray *events;
+
+    janet_fixarity(argc, 2);
+
+    input = jwlr_get_virtual_input(argv, 0);
+    path = janet_getcstring(argv, 1);
+
+    /* Parse everything first, so that a broken file doesn't emit half of it */
+    events = jwlr_read_virtual_input_file(path);
+    for (int32_t i = 0; i < events->count; i++) {
+        JanetView event;
+        if (!janet_indexed_view(events->data[i], &event.items, &event.len)) {
+            janet_panicf("%s: expected an indexed virtual input event, got %v", path, events->data[i]);
+        }
+        jwlr_virtual_input_emit(input, event.len, event.items);
+    }
+    return janet_wrap_integer(events->count);
+}
+
+
+/* Input logs are a header followed by fixed-size records. The recorder
+   keeps the count in the header up to date, so that a log stays readable
+   even if the compositor dies while recording. */
+#define JWLR_INPUT_LOG_MAGIC 0x524c494a /* "JILR" */
+#define JWLR_INPUT_LOG_VERSION 1
+#define JWLR_INPUT_REPLAY_CHUNK 256
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t count;
+} jwlr_input_log_header_t;
+
+typedef struct jwlr_input_recorder jwlr_input_recorder_t;
+
+typedef struct {
+    jwlr_input_recorder_t *recorder;
+    struct wlr_keyboard *keyboard;
+    struct wl_listener key;
+    struct wl_listener destroy;
+    struct wl_list link;
+} jwlr_input_recorder_keyboard_t;
+
+struct jwlr_input_recorder {
+    int active;
+    int fd;
+    void *map;
+    size_t map_size;
+    jwlr_input_log_header_t *header;
+    jwlr_input_record_t *records;
+    uint64_t capacity;
+    uint64_t dropped;
+    struct timespec start;
+    struct wl_listener motion;
+    struct wl_listener motion_absolute;
+    struct wl_listener button;
+    struct wl_listener axis;
+    struct wl_listener frame;
+    struct wl_list keyboards;
+};
+
+typedef struct {
+    int active;
+    int mode;
+    void *map;
+    size_t map_size;
+    const jwlr_input_record_t *records;
+    uint64_t count;
+    uint64_t next;
+    struct timespec start;
+    struct wl_event_loop *event_loop;
+    struct wl_event_source *timer;
+    struct wl_event_source *idle;
+    jwlr_virtual_input_obj_t *pointer;
+    jwlr_virtual_input_obj_t *keyboard;
+    JanetFunction *on_done;
+} jwlr_input_replayer_t;
+
+
+static uint64_t jwlr_timespec_diff_nsec(const struct timespec *from, const struct timespec *to)
+{
+    return (uint64_t)(to->tv_sec - from->tv_sec) * 1000000000 + (to->tv_nsec - from->tv_nsec);
+}
+
+
+static jwlr_input_record_t *jwlr_input_recorder_append(jwlr_input_recorder_t *recorder, uint32_t type)
+{
+    struct timespec now;
+    jwlr_input_record_t *rec;
+
+    if (recorder->header->count >= recorder->capacity) {
+        recorder->dropped++;
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    rec = &recorder->records[recorder->header->count];
+    memset(rec, 0, sizeof(*rec));
+    rec->time_nsec = jwlr_timespec_diff_nsec(&recorder->start, &now);
+    rec->type = type;
+    return rec;
+}
+
+
+static void jwlr_input_recorder_commit(jwlr_input_recorder_t *recorder)
+{
+    recorder->header->count++;
+}
+
+
+static void jwlr_input_recorder_handle_motion(struct wl_listener *listener, void *data)
+{
+    jwlr_input_recorder_t *recorder = wl_container_of(listener, recorder, motion);
+    struct wlr_pointer_motion_event *event = data;
+    jwlr_input_record_t *rec = jwlr_input_recorder_append(recorder, JWLR_VIRTUAL_EVENT_MOTION);
+    if (rec) {
+        rec->a = event->delta_x;
+        rec->b = event->delta_y;
+        jwlr_input_recorder_commit(recorder);
+    }
+}
+
+
+static void jwlr_input_recorder_handle_motion_absolute(struct wl_listener *listener, void *data)
+{
+    jwlr_input_recorder_t *recorder = wl_container_of(listener, recorder, motion_absolute);
+    struct wlr_pointer_motion_absolute_event *event = data;
+    jwlr_input_record_t *rec = jwlr_input_recorder_append(recorder, JWLR_VIRTUAL_EVENT_MOTION_ABSOLUTE);
+    if (rec) {
+        rec->a = event->x;
+        rec->b = event->y;
+        jwlr_input_recorder_commit(recorder);
+    }
+}
+
+
+static void jwlr_input_recorder_handle_button(struct wl_listener *listener, void *data)
+{
+    jwlr_input_recorder_t *recorder = wl_container_of(listener, recorder, button);
+    struct wlr_pointer_button_event *event = data;
+    jwlr_input_record_t *rec = jwlr_input_recorder_append(recorder, JWLR_VIRTUAL_EVENT_BUTTON);
+    if (rec) {
+        rec->code = event->button;
+        rec->state = event->state;
+        jwlr_input_recorder_commit(recorder);
+    }
+}
+
+
+static void jwlr_input_recorder_handle_axis(struct wl_listener *listener, void *data)
+{
+    jwlr_input_recorder_t *recorder = wl_container_of(listener, recorder, axis);
+    struct wlr_pointer_axis_event *event = data;
+    jwlr_input_record_t *rec = jwlr_input_recorder_append(recorder, JWLR_VIRTUAL_EVENT_AXIS);
+    if (rec) {
+        rec->code = event->orientation;
+        rec->state = event->source;
+        rec->a = event->delta;
+        rec->discrete = event->delta_discrete;
+        jwlr_input_recorder_commit(recorder);
+    }
+}
+
+
+static void jwlr_input_recorder_handle_frame(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_input_recorder_t *recorder = wl_container_of(listener, recorder, frame);
+    if (jwlr_input_recorder_append(recorder, JWLR_VIRTUAL_EVENT_FRAME)) {
+        jwlr_input_recorder_commit(recorder);
+    }
+}
+
+
+static void jwlr_input_recorder_handle_key(struct wl_listener *listener, void *data)
+{
+    jwlr_input_recorder_keyboard_t *rkeyboard = wl_container_of(listener, rkeyboard, key);
+    struct wlr_keyboard_key_event *event = data;
+    jwlr_input_record_t *rec = jwlr_input_recorder_append(rkeyboard->recorder, JWLR_VIRTUAL_EVENT_KEY);
+    if (rec) {
+        rec->code = event->keycode;
+        rec->state = event->state;
+        jwlr_input_recorder_commit(rkeyboard->recorder);
+    }
+}
+
+
+static void jwlr_input_recorder_keyboard_free(jwlr_input_recorder_keyboard_t *rkeyboard)
+{
+    wl_list_remove(&rkeyboard->key.link);
+    wl_list_remove(&rkeyboard->destroy.link);
+    wl_list_remove(&rkeyboard->link);
+    free(rkeyboard);
+}
+
+
+static void jwlr_input_recorder_handle_keyboard_destroy(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_input_recorder_keyboard_t *rkeyboard = wl_container_of(listener, rkeyboard, destroy);
+    jwlr_input_recorder_keyboard_free(rkeyboard);
+}
+
+
+static void jwlr_input_recorder_close(jwlr_input_recorder_t *recorder)
+{
+    jwlr_input_recorder_keyboard_t *rkeyboard, *tmp;
+    size_t used_size;
+
+    if (!recorder->active) {
+        return;
+    }
+    recorder->active = 0;
+
+    wl_list_remove(&recorder->motion.link);
+    wl_list_remove(&recorder->motion_absolute.link);
+    wl_list_remove(&recorder->button.link);
+    wl_list_remove(&recorder->axis.link);
+    wl_list_remove(&recorder->frame.link);
+    wl_list_for_each_safe(rkeyboard, tmp, &recorder->keyboards, link) {
+        jwlr_input_recorder_keyboard_free(rkeyboard);
+    }
+
+    used_size = sizeof(jwlr_input_log_header_t) + recorder->header->count * sizeof(jwlr_input_record_t);
+    munmap(recorder->map, recorder->map_size);
+    recorder->map = NULL;
+    recorder->header = NULL;
+    recorder->records = NULL;
+    /* Drop the unused preallocated space */
+    if (ftruncate(recorder->fd, used_size) < 0) {
+        fprintf(stderr, "failed to truncate input log: %d\n", errno);
+    }
+    close(recorder->fd);
+    recorder->fd = -1;
+}
+
+
+static int method_input_recorder_gc(void *p, size_t len)
+{
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    jwlr_input_recorder_close((jwlr_input_recorder_t *)p);
+    return 0;
+}
+
+
+static int method_input_recorder_get(void *p, Janet key, Janet *out)
+{
+    jwlr_input_recorder_t *recorder = (jwlr_input_recorder_t *)p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "active")) {
+        *out = janet_wrap_boolean(recorder->active);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "count")) {
+        *out = recorder->active ? janet_wrap_number((double)recorder->header->count) : janet_wrap_nil();
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "capacity")) {
+        *out = janet_wrap_number((double)recorder->capacity);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "dropped")) {
+        *out = janet_wrap_number((double)recorder->dropped);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static Janet cfun_wlr_input_recorder_create(int32_t argc, Janet *argv)
+{
+    const char *path;
+    struct wlr_cursor *cursor;
+    uint64_t capacity;
+
+    jwlr_input_recorder_t *recorder;
+    size_t map_size;
+    int fd;
+    void *map;
+
+    janet_arity(argc, 2, 3);
+
+    path = janet_getcstring(argv, 0);
+    cursor = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_cursor);
+    capacity = (uint64_t)janet_optnat(argv, argc, 2, 1 << 20);
+    if (0 == capacity) {
+        janet_panic("capacity must be positive");
+    }
+
+    map_size = sizeof(jwlr_input_log_header_t) + capacity * sizeof(jwlr_input_record_t);
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        janet_panicf("failed to open %s: %d", path, errno);
+    }
+    if (ftruncate(fd, map_size) < 0) {
+        int err = errno;
+        close(fd);
+        janet_panicf("failed to allocate input log: %d", err);
+    }
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == map) {
+        int err = errno;
+        close(fd);
+        janet_panicf("failed to map input log: %d", err);
+    }
+
+    recorder = janet_abstract(&jwlr_at_input_recorder, sizeof(*recorder));
+    recorder->active = 1;
+    recorder->fd = fd;
+    recorder->map = map;
+    recorder->map_size = map_size;
+    recorder->header = map;
+    recorder->records = (jwlr_input_record_t *)(recorder->header + 1);
+    recorder->capacity = capacity;
+    recorder->dropped = 0;
+    clock_gettime(CLOCK_MONOTONIC, &recorder->start);
+
+    recorder->header->magic = JWLR_INPUT_LOG_MAGIC;
+    recorder->header->version = JWLR_INPUT_LOG_VERSION;
+    recorder->header->record_size = sizeof(jwlr_input_record_t);
+    recorder->header->reserved = 0;
+    recorder->header->count = 0;
+
+    recorder->motion.notify = jwlr_input_recorder_handle_motion;
+    wl_signal_add(&cursor->events.motion, &recorder->motion);
+    recorder->motion_absolute.notify = jwlr_input_recorder_handle_motion_absolute;
+    wl_signal_add(&cursor->events.motion_absolute, &recorder->motion_absolute);
+    recorder->button.notify = jwlr_input_recorder_handle_button;
+    wl_signal_add(&cursor->events.button, &recorder->button);
+    recorder->axis.notify = jwlr_input_recorder_handle_axis;
+    wl_signal_add(&cursor->events.axis, &recorder->axis);
+    recorder->frame.notify = jwlr_input_recorder_handle_frame;
+    wl_signal_add(&cursor->events.frame, &recorder->frame);
+    wl_list_init(&recorder->keyboards);
+
+    /* The listeners point into the abstract object */
+    janet_gcroot(janet_wrap_abstract(recorder));
+    return janet_wrap_abstract(recorder);
+}
+
+
+static Janet cfun_wlr_input_recorder_add_keyboard(int32_t argc, Janet *argv)
+{
+    jwlr_input_recorder_t *recorder;
+    struct wlr_keyboard *keyboard;
+
+    jwlr_input_recorder_keyboard_t *rkeyboard;
+
+    janet_fixarity(argc, 2);
+
+    recorder = janet_getabstract(argv, 0, &jwlr_at_input_recorder);
+    keyboard = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_keyboard);
+    if (!recorder->active) {
+        janet_panic("input recorder is already stopped");
+    }
+
+    rkeyboard = malloc(sizeof(*rkeyboard));
+    if (!rkeyboard) {
+        JANET_OUT_OF_MEMORY;
+    }
+    rkeyboard->recorder = recorder;
+    rkeyboard->keyboard = keyboard;
+    rkeyboard->key.notify = jwlr_input_recorder_handle_key;
+    wl_signal_add(&keyboard->events.key, &rkeyboard->key);
+    rkeyboard->destroy.notify = jwlr_input_recorder_handle_keyboard_destroy;
+    wl_signal_add(&keyboard->base.events.destroy, &rkeyboard->destroy);
+    wl_list_insert(&recorder->keyboards, &rkeyboard->link);
+
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_input_recorder_stop(int32_t argc, Janet *argv)
+{
+    jwlr_input_recorder_t *recorder;
+
+    uint64_t count;
+
+    janet_fixarity(argc, 1);
+
+    recorder = janet_getabstract(argv, 0, &jwlr_at_input_recorder);
+    if (!recorder->active) {
+        return janet_wrap_nil();
+    }
+    count = recorder->header->count;
+    jwlr_input_recorder_close(recorder);
+    janet_gcunroot(janet_wrap_abstract(recorder));
+    return janet_wrap_number((double)count);
+}
+
+
+static void jwlr_input_replayer_release(jwlr_input_replayer_t *replayer)
+{
+    if (!replayer->active) {
+        return;
+    }
+    replayer->active = 0;
+    if (replayer->timer) {
+        wl_event_source_remove(replayer->timer);
+        replayer->timer = NULL;
+    }
+    if (replayer->idle) {
+        wl_event_source_remove(replayer->idle);
+        replayer->idle = NULL;
+    }
+    munmap(replayer->map, replayer->map_size);
+    replayer->map = NULL;
+    replayer->records = NULL;
+}
+
+
+static void jwlr_input_replayer_finish(jwlr_input_replayer_t *replayer, int completed)
+{
+    JanetFunction *on_done = replayer->on_done;
+
+    jwlr_input_replayer_release(replayer);
+
+    if (on_done) {
+        Janet argv[] = {
+            janet_wrap_boolean(completed),
+        };
+        Janet ret = janet_wrap_nil();
+        JanetFiber *fiber = NULL;
+
+        int locked = janet_gclock();
+        int sig = janet_pcall(on_done, 1, argv, &ret, &fiber);
+        janet_gcunlock(locked);
+        if (JANET_SIGNAL_OK != sig) {
+            janet_stacktrace(fiber, ret);
+        }
+    }
+
+    janet_gcunroot(janet_wrap_abstract(replayer));
+}
+
+
+static void jwlr_input_replayer_emit(jwlr_input_replayer_t *replayer, const jwlr_input_record_t *rec)
+{
+    jwlr_virtual_input_obj_t *obj =
+        JWLR_VIRTUAL_EVENT_KEY == rec->type ? replayer->keyboard : replayer->pointer;
+    struct timespec now;
+
+    if (!obj || !obj->input) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    jwlr_input_record_emit(obj->input, rec, (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000));
+}
+
+
+static int jwlr_input_replayer_handle_timer(void *data);
+static void jwlr_input_replayer_handle_idle(void *data);
+
+static void jwlr_input_replayer_run(jwlr_input_replayer_t *replayer)
+{
+    if (JWLR_INPUT_REPLAY_FAST == replayer->mode) {
+        uint64_t end = replayer->next + JWLR_INPUT_REPLAY_CHUNK;
+        if (end > replayer->count) {
+            end = replayer->count;
+        }
+        while (replayer->active && replayer->next < end) {
+            jwlr_input_replayer_emit(replayer, &replayer->records[replayer->next++]);
+        }
+        if (!replayer->active) {
+            /* Stopped by an event handler */
+            return;
+        }
+        if (replayer->next < replayer->count) {
+            /* Let the compositor breathe between chunks */
+            replayer->idle = wl_event_loop_add_idle(replayer->event_loop,
+                                                    jwlr_input_replayer_handle_idle,
+                                                    replayer);
+            return;
+        }
+    } else {
+        struct timespec now;
+        uint64_t elapsed;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = jwlr_timespec_diff_nsec(&replayer->start, &now);
+        while (replayer->active && replayer->next < replayer->count
+               && replayer->records[replayer->next].time_nsec <= elapsed) {
+            jwlr_input_replayer_emit(replayer, &replayer->records[replayer->next++]);
+        }
+        if (!replayer->active) {
+            return;
+        }
+        if (replayer->next < replayer->count) {
+            uint64_t delay_nsec = replayer->records[replayer->next].time_nsec - elapsed;
+            int delay_ms = (int)((delay_nsec + 999999) / 1000000);
+            wl_event_source_timer_update(replayer->timer, delay_ms > 0 ? delay_ms : 1);
+            return;
+        }
+    }
+
+    jwlr_input_replayer_finish(replayer, 1);
+}
+
+
+static int jwlr_input_replayer_handle_timer(void *data)
+{
+    jwlr_input_replayer_run((jwlr_input_replayer_t *)data);
+    return 0;
+}
+
+
+static void jwlr_input_replayer_handle_idle(void *data)
+{
+    jwlr_input_replayer_t *replayer = (jwlr_input_replayer_t *)data;
+    /* Idle sources are removed automatically after firing */
+    replayer->idle = NULL;
+    jwlr_input_replayer_run(replayer);
+}
+
+
+static int method_input_replayer_gc(void *p, size_t len)
+{
+    (void)len;
+    JL_STATS_COUNT_GC(p);
+    jwlr_input_replayer_release((jwlr_input_replayer_t *)p);
+    return 0;
+}
+
+
+static int method_input_replayer_gcmark(void *p, size_t len)
+{
+    (void)len;
+    jwlr_input_replayer_t *replayer = (jwlr_input_replayer_t *)p;
+
+    if (replayer->pointer) {
+        janet_mark(janet_wrap_abstract(replayer->pointer));
+    }
+    if (replayer->keyboard) {
+        janet_mark(janet_wrap_abstract(replayer->keyboard));
+    }
+    if (replayer->on_done) {
+        janet_mark(janet_wrap_function(replayer->on_done));
+    }
+    return 0;
+}
+
+
+static int method_input_replayer_get(void *p, Janet key, Janet *out)
+{
+    jwlr_input_replayer_t *replayer = (jwlr_input_replayer_t *)p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "active")) {
+        *out = janet_wrap_boolean(replayer->active);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "count")) {
+        *out = janet_wrap_number((double)replayer->count);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "position")) {
+        *out = janet_wrap_number((double)replayer->next);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static jwlr_virtual_input_obj_t *jwlr_opt_virtual_input_obj(const Janet *argv, int32_t n)
+{
+    if (janet_checktype(argv[n], JANET_NIL)) {
+        return NULL;
+    }
+    return janet_getabstract(argv, n, &jwlr_at_virtual_input);
+}
+
+
+static Janet cfun_wlr_input_replayer_create(int32_t argc, Janet *argv)
+{
+    struct wl_event_loop *event_loop;
+    const char *path;
+    jwlr_virtual_input_obj_t *pointer;
+    jwlr_virtual_input_obj_t *keyboard;
+    int mode = JWLR_INPUT_REPLAY_REALTIME;
+    JanetFunction *on_done = NULL;
+
+    jwlr_input_replayer_t *replayer;
+    struct stat st;
+    const jwlr_input_log_header_t *header;
+    int fd;
+    void *map;
+
+    janet_arity(argc, 4, 6);
+
+    event_loop = jl_get_abs_obj_pointer_by_name(argv, 0, WL_MOD_NAME "/wl-event-loop");
+    path = janet_getcstring(argv, 1);
+    pointer = jwlr_opt_virtual_input_obj(argv, 2);
+    keyboard = jwlr_opt_virtual_input_obj(argv, 3);
+    if (argc > 4 && !janet_checktype(argv[4], JANET_NIL)) {
+        mode = jl_get_key_def(argv, 4, input_replay_mode_defs);
+    }
+    if (argc > 5 && !janet_checktype(argv[5], JANET_NIL)) {
+        on_done = janet_getfunction(argv, 5);
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        janet_panicf("failed to open %s: %d", path, errno);
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(jwlr_input_log_header_t)) {
+        close(fd);
+        janet_panicf("%s is not an input log", path);
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == map) {
+        int err = errno;
+        close(fd);
+        janet_panicf("failed to map input log: %d", err);
+    }
+    /* The mapping stays valid without the fd */
+    close(fd);
+
+    header = map;
+    if (JWLR_INPUT_LOG_MAGIC != header->magic
+            || JWLR_INPUT_LOG_VERSION != header->version
+            || sizeof(jwlr_input_record_t) != header->record_size
+            || header->count > (st.st_size - sizeof(*header)) / sizeof(jwlr_input_record_t)) {
+        munmap(map, st.st_size);
+        janet_panicf("%s is not a valid input log", path);
+    }
+
+    replayer = janet_abstract(&jwlr_at_input_replayer, sizeof(*replayer));
+    replayer->active = 1;
+    replayer->mode = mode;
+    replayer->map = map;
+    replayer->map_size = st.st_size;
+    replayer->records = (const jwlr_input_record_t *)(header + 1);
+    replayer->count = header->count;
+    replayer->next = 0;
+    replayer->event_loop = event_loop;
+    replayer->timer = NULL;
+    replayer->idle = NULL;
+    replayer->pointer = pointer;
+    replayer->keyboard = keyboard;
+    replayer->on_done = on_done;
+    clock_gettime(CLOCK_MONOTONIC, &replayer->start);
+
+    if (JWLR_INPUT_REPLAY_FAST == mode) {
+        replayer->idle = wl_event_loop_add_idle(event_loop, jwlr_input_replayer_handle_idle, replayer);
+    } else {
+        replayer->timer = wl_event_loop_add_timer(event_loop, jwlr_input_replayer_handle_timer, replayer);
+        if (replayer->timer) {
+            wl_event_source_timer_update(replayer->timer, 1);
+        }
+    }
+    if (!replayer->timer && !replayer->idle) {
+        jwlr_input_replayer_release(replayer);
+        janet_panic("failed to add event source");
+    }
+
+    /* Events get replayed from the event loop, keep the replayer alive */
+    janet_gcroot(janet_wrap_abstract(replayer));
+    return janet_wrap_abstract(replayer);
+}
+
+
+static Janet cfun_wlr_input_replayer_stop(int32_t argc, Janet *argv)
+{
+    jwlr_input_replayer_t *replayer;
+
+    janet_fixarity(argc, 1);
+
+    replayer = janet_getabstract(argv, 0, &jwlr_at_input_replayer);
+    if (replayer->active) {
+        jwlr_input_replayer_finish(replayer, 0);
+    }
+    return janet_wrap_nil();
+}
+
+
+static int method_wlr_keyboard_key_event_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_keyboard_key_event **event_p = (struct wlr_keyboard_key_event **)p;
+    struct wlr_keyboard_key_event *event = *event_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "time-msec")) {
+        /* uint32_t -> uint64_t */
+        *out = janet_wrap_u64(event->time_msec);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "keycode")) {
+        /* uint32_t -> uint64_t */
+        *out = janet_wrap_u64(event->keycode);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "update-state")) {
+        *out = janet_wrap_boolean(event->update_state);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "state")) {
+        *out = janet_ckeywordv(wl_keyboard_key_state_defs[event->state].name);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_keyboard_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_keyboard **keyboard_p = (struct wlr_keyboard **)p;
+    struct wlr_keyboard *keyboard = *keyboard_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    struct wl_signal **signal_p = get_abstract_struct_signal_member(keyboard, kw, wlr_keyboard_signal_offsets);
+    if (signal_p) {
+        *out = janet_wrap_abstract(signal_p);
+        return 1;
+    }
+
+    if (!janet_cstrcmp(kw, "base")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&keyboard->base, &jwlr_at_wlr_input_device));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "keymap-string")) {
+        if (!(keyboard->keymap_string)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        JanetBuffer *buf = janet_buffer(keyboard->keymap_size);
+        janet_buffer_push_bytes(buf, (uint8_t *)keyboard->keymap_string, keyboard->keymap_size);
+        *out = janet_wrap_buffer(buf);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "xkb-state")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj_by_name(keyboard->xkb_state,
+                                                                 XKB_MOD_NAME "/xkb-state"));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "keycodes")) {
+        JanetArray *kc_arr = janet_array(keyboard->num_keycodes);
+        for (size_t i = 0; i < keyboard->num_keycodes; i++) {
+            janet_array_push(kc_arr, janet_wrap_u64(keyboard->keycodes[i]));
+        }
+        *out = janet_wrap_array(kc_arr);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "modifiers")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&keyboard->modifiers,
+                                                         &jwlr_at_wlr_keyboard_modifiers));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "data")) {
+        if (!(keyboard->data)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_pointer(keyboard->data);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_pointer_motion_event_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_pointer_motion_event **event_p = (struct wlr_pointer_motion_event **)p;
+    struct wlr_pointer_motion_event *event = *event_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "pointer")) {
+        if (!(event->pointer)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "time-msec")) {
+        /* uint32_t -> uint64_t */
+        *out = janet_wrap_u64(event->time_msec);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "delta-x")) {
+        *out = janet_wrap_number(event->delta_x);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "delta-y")) {
+        *out = janet_wrap_number(event->delta_y);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "unaccel-dx")) {
+        *out = janet_wrap_number(event->unaccel_dx);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "unaccel-dy")) {
+        *out = janet_wrap_number(event->unaccel_dy);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_pointer_motion_absolute_event_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_pointer_motion_absolute_event **event_p = (struct wlr_pointer_motion_absolute_event **)p;
+    struct wlr_pointer_motion_absolute_event *event = *event_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "pointer")) {
+        if (!(event->pointer)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "time-msec")) {
+        /* uint32_t -> uint64_t */
+        *out = janet_wrap_u64(event->time_msec);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "x")) {
+        *out = janet_wrap_number(event->x);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "y")) {
+        *out = janet_wrap_number(event->y);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_pointer_button_event_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_pointer_button_event **event_p = (struct wlr_pointer_button_event **)p;
+    struct wlr_pointer_button_event *event = *event_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "pointer")) {
+        if (!(event->pointer)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "time-msec")) {
+        /* uint32_t -> uint64_t */
+        *out = janet_wrap_u64(event->time_msec);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "button")) {
+        /* uint32_t -> uint64_t */
+        *out = janet_wrap_u64(event->button);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "state")) {
+        if (event->state >= __WLR_BUTTON_STATE_DEFS_COUNT) {
+            janet_panicf("unknown button state from wlroots pointer button event: %d", event->state);
+        }
+        *out = janet_ckeywordv(wlr_button_state_defs[event->state].name);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_pointer_axis_event_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_pointer_axis_event **event_p = (struct wlr_pointer_axis_event **)p;
+    struct wlr_pointer_axis_event *event = *event_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "pointer")) {
+        if (!(event->pointer)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "time-msec")) {
+        /* uint32_t -> uint64_t */
+        *out = janet_wrap_u64(event->time_msec);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "source")) {
+        if (event->source >= __WLR_AXIS_SOURCE_DEFS_COUNT) {
+            janet_panicf("unknown axis source from wlroots pointer axis event: %d", event->source);
+        }
+        *out = janet_ckeywordv(wlr_axis_source_defs[event->source].name);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "orientation")) {
+        if (event->orientation >= __WLR_AXIS_ORIENTATION_DEFS_COUNT) {
+            janet_panicf("unknown axis orientation from wlroots pointer axis event: %d", event->orientation);
+        }
+        *out = janet_ckeywordv(wlr_axis_orientation_defs[event->orientation].name);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "delta")) {
+        *out = janet_wrap_number(event->delta);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "delta-discrete")) {
+        *out = janet_wrap_integer(event->delta_discrete);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_seat_pointer_state_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_seat_pointer_state **state_p = (struct wlr_seat_pointer_state **)p;
+    struct wlr_seat_pointer_state *state = *state_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    struct wl_signal **signal_p = get_abstract_struct_signal_member(state, kw, wlr_seat_pointer_state_signal_offsets);
+    if (signal_p) {
+        *out = janet_wrap_abstract(signal_p);
+        return 1;
+    }
+
+    if (!janet_cstrcmp(kw, "seat")) {
+        if (!(state->seat)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->seat, &jwlr_at_wlr_seat));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "focused-client")) {
+        if (!(state->focused_client)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_client, &jwlr_at_wlr_seat_client));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "focused-surface")) {
+        if (!(state->focused_surface)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_surface, &jwlr_at_wlr_surface));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "sx")) {
+        *out = janet_wrap_number(state->sx);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "sy")) {
+        *out = janet_wrap_number(state->sy);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_seat_keyboard_state_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_seat_keyboard_state **state_p = (struct wlr_seat_keyboard_state **)p;
+    struct wlr_seat_keyboard_state *state = *state_p;
+    
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    struct wl_signal **signal_p = get_abstract_struct_signal_member(state, kw,
+                                                                    wlr_seat_keyboard_state_signal_offsets);
+    if (signal_p) {
+        *out = janet_wrap_abstract(signal_p);
+        return 1;
+    }
+
+    if (!janet_cstrcmp(kw, "seat")) {
+        if (!(state->seat)) {
+            *out = janet_wrap_nil();
+            return 1;
         }
-        JanetBuffer *buf = janet_buffer(keyboard->keymap_size);
-        janet_buffer_push_bytes(buf, (uint8_t *)keyboard->keymap_string, keyboard->keymap_size);
-        *out = janet_wrap_buffer(buf);
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->seat, &jwlr_at_wlr_seat));
         return 1;
     }
-    if (!janet_cstrcmp(kw, "xkb-state")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj_by_name(keyboard->xkb_state,
-                                                                 XKB_MOD_NAME "/xkb-state"));
+    if (!janet_cstrcmp(kw, "keyboard")) {
+        if (!(state->keyboard)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->keyboard, &jwlr_at_wlr_keyboard));
         return 1;
     }
-    if (!janet_cstrcmp(kw, "keycodes")) {
-        JanetArray *kc_arr = janet_array(keyboard->num_keycodes);
-        for (size_t i = 0; i < keyboard->num_keycodes; i++) {
-            janet_array_push(kc_arr, janet_wrap_u64(keyboard->keycodes[i]));
+    if (!janet_cstrcmp(kw, "focused-client")) {
+        if (!(state->focused_client)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_client, &jwlr_at_wlr_seat_client));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "focused-surface")) {
+        if (!(state->focused_surface)) {
+            *out = janet_wrap_nil();
+            return 1;
+        }
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_surface, &jwlr_at_wlr_surface));
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_seat_pointer_request_set_cursor_event_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_seat_pointer_request_set_cursor_event **event_p = (struct wlr_seat_pointer_request_set_cursor_event **)p;
+    struct wlr_seat_pointer_request_set_cursor_event *event = *event_p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "seat-client")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->seat_client, &jwlr_at_wlr_seat_client));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "surface")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->surface, &jwlr_at_wlr_surface));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "serial")) {
+        /* XXX: uint32_t -> int32_t conversion */
+        *out = janet_wrap_integer(event->serial);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "hotspot-x")) {
+        *out = janet_wrap_integer(event->hotspot_x);
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "hotspot-y")) {
+        *out = janet_wrap_integer(event->hotspot_y);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int method_wlr_seat_request_set_selection_event_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_seat_request_set_selection_event **event_p = (struct wlr_seat_request_set_selection_event **)p;
+    struct wlr_seat_request_set_selection_event *event = *event_p;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        janet_panicf("expected keyword, got %v", key);
+    }
+
+    const uint8_t *kw = janet_unwrap_keyword(key);
+
+    if (!janet_cstrcmp(kw, "source")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->source, &jwlr_at_wlr_data_source));
+        return 1;
+    }
+    if (!janet_cstrcmp(kw, "serial")) {
+        /* XXX: uint32_t -> int32_t conversion */
+        *out = janet_wrap_integer(event->serial);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static Janet cfun_wlr_scene_get_scene_output(int32_t argc, Janet *argv)
+{
+    struct wlr_scene *scene;
+    struct wlr_output *output;
+
+    struct wlr_scene_output *scene_output;
+
+    janet_fixarity(argc, 2);
+
+    scene = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene);
+    output = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_output);
+
+    scene_output = wlr_scene_get_scene_output(scene, output);
+    if (!scene_output) {
+        janet_panic("failed to create wlroots scene output object");
+    }
+    return janet_wrap_abstract(jl_pointer_to_abs_obj(scene_output, &jwlr_at_wlr_scene_output));
+}
+
+
+/* Per-output frame timing, attached to outputs as addons so that commits
+   can find it without any lookup tables. Histogram buckets are bounded by
+   jwlr_frame_stats_bounds_us, plus one last bucket for slower frames. */
+static const uint32_t jwlr_frame_stats_bounds_us[] = {
+    500, 1000, 2000, 4000, 8000, 16667, 33333, 66667,
+};
+#define JWLR_FRAME_STATS_BUCKETS (sizeof(jwlr_frame_stats_bounds_us) / sizeof(jwlr_frame_stats_bounds_us[0]) + 1)
+
+typedef struct {
+    uint64_t hist[JWLR_FRAME_STATS_BUCKETS];
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} jwlr_frame_stats_hist_t;
+
+typedef struct {
+    struct wlr_addon addon;
+    struct wl_listener frame;
+    /* Time of the latest frame event, 0 once a commit consumed it */
+    uint64_t frame_ns;
+    uint64_t failed_commits;
+    jwlr_frame_stats_hist_t latency;
+    jwlr_frame_stats_hist_t commit;
+} jwlr_output_frame_stats_t;
+
+
+static void jwlr_frame_stats_hist_add(jwlr_frame_stats_hist_t *hist, uint64_t ns)
+{
+    size_t i;
+    uint64_t us = ns / 1000;
+
+    for (i = 0; i < JWLR_FRAME_STATS_BUCKETS - 1; i++) {
+        if (us < jwlr_frame_stats_bounds_us[i]) {
+            break;
+        }
+    }
+    hist->hist[i]++;
+    hist->count++;
+    hist->total_ns += ns;
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+}
+
+
+static void jwlr_output_frame_stats_free(jwlr_output_frame_stats_t *stats)
+{
+    wl_list_remove(&stats->frame.link);
+    wlr_addon_finish(&stats->addon);
+    free(stats);
+}
+
+
+static void jwlr_output_frame_stats_addon_destroy(struct wlr_addon *addon)
+{
+    jwlr_output_frame_stats_t *stats = wl_container_of(addon, stats, addon);
+    jwlr_output_frame_stats_free(stats);
+}
+
+static const struct wlr_addon_interface jwlr_output_frame_stats_addon_impl = {
+    .name = "janetland-output-frame-stats",
+    .destroy = jwlr_output_frame_stats_addon_destroy,
+};
+
+
+static jwlr_output_frame_stats_t *jwlr_output_frame_stats_find(struct wlr_output *output)
+{
+    struct wlr_addon *addon = wlr_addon_find(&output->addons, NULL, &jwlr_output_frame_stats_addon_impl);
+    if (!addon) {
+        return NULL;
+    }
+    jwlr_output_frame_stats_t *stats = wl_container_of(addon, stats, addon);
+    return stats;
+}
+
+
+static void jwlr_output_frame_stats_handle_frame(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_output_frame_stats_t *stats = wl_container_of(listener, stats, frame);
+    stats->frame_ns = jl_trace_now();
+}
+
+
+/* Commits a scene output, recording the timing in the trace ring and the
+   output's frame stats, when enabled */
+static bool jwlr_scene_output_commit_measured(struct wlr_scene_output *scene_output)
+{
+    jwlr_output_frame_stats_t *stats = jwlr_output_frame_stats_find(scene_output->output);
+    uint64_t start_ns, end_ns;
+    bool ret;
+
+    if (!stats && !jwlr_trace_ring) {
+        return wlr_scene_output_commit(scene_output);
+    }
+
+    start_ns = jl_trace_now();
+    ret = wlr_scene_output_commit(scene_output);
+    end_ns = jl_trace_now();
+
+    if (jwlr_trace_ring) {
+        jl_trace_record(jwlr_trace_ring, "render", "scene-commit", start_ns, end_ns);
+    }
+    if (stats) {
+        jwlr_frame_stats_hist_add(&stats->commit, end_ns - start_ns);
+        if (stats->frame_ns) {
+            jwlr_frame_stats_hist_add(&stats->latency, end_ns - stats->frame_ns);
+            stats->frame_ns = 0;
+        }
+        if (!ret) {
+            stats->failed_commits++;
+        }
+    }
+    return ret;
+}
+
+
+static Janet jwlr_frame_stats_hist_to_struct(jwlr_frame_stats_hist_t *hist)
+{
+    Janet buckets[JWLR_FRAME_STATS_BUCKETS];
+    JanetKV *st = janet_struct_begin(4);
+
+    for (size_t i = 0; i < JWLR_FRAME_STATS_BUCKETS; i++) {
+        buckets[i] = janet_wrap_number((double)hist->hist[i]);
+    }
+    janet_struct_put(st, janet_ckeywordv("hist"), janet_wrap_tuple(janet_tuple_n(buckets, JWLR_FRAME_STATS_BUCKETS)));
+    janet_struct_put(st, janet_ckeywordv("count"), janet_wrap_number((double)hist->count));
+    janet_struct_put(st, janet_ckeywordv("mean-ms"),
+                     janet_wrap_number(hist->count ? hist->total_ns / 1e6 / hist->count : 0.0));
+    janet_struct_put(st, janet_ckeywordv("max-ms"), janet_wrap_number(hist->max_ns / 1e6));
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+
+static Janet cfun_wlr_output_frame_stats_enable(int32_t argc, Janet *argv)
+{
+    struct wlr_output *output;
+
+    jwlr_output_frame_stats_t *stats;
+
+    janet_fixarity(argc, 1);
+
+    output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_output);
+    if (jwlr_output_frame_stats_find(output)) {
+        return janet_wrap_false();
+    }
+
+    stats = calloc(1, sizeof(*stats));
+    if (!stats) {
+        JANET_OUT_OF_MEMORY;
+    }
+    wlr_addon_init(&stats->addon, &output->addons, NULL, &jwlr_output_frame_stats_addon_impl);
+    stats->frame.notify = jwlr_output_frame_stats_handle_frame;
+    /* Insert at the head of the listener list, so that the frame time is
+       recorded before any other frame listener gets to commit */
+    wl_list_insert(&output->events.frame.listener_list, &stats->frame.link);
+    return janet_wrap_true();
+}
+
+
+static Janet cfun_wlr_output_frame_stats_disable(int32_t argc, Janet *argv)
+{
+    struct wlr_output *output;
+
+    jwlr_output_frame_stats_t *stats;
+
+    janet_fixarity(argc, 1);
+
+    output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_output);
+    stats = jwlr_output_frame_stats_find(output);
+    if (stats) {
+        jwlr_output_frame_stats_free(stats);
+    }
+    return janet_wrap_boolean(NULL != stats);
+}
+
+
+static Janet cfun_wlr_output_frame_stats(int32_t argc, Janet *argv)
+{
+    struct wlr_output *output;
+
+    jwlr_output_frame_stats_t *stats;
+    Janet bounds[JWLR_FRAME_STATS_BUCKETS - 1];
+    JanetKV *st;
+
+    janet_fixarity(argc, 1);
+
+    output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_output);
+    stats = jwlr_output_frame_stats_find(output);
+    if (!stats) {
+        return janet_wrap_nil();
+    }
+
+    for (size_t i = 0; i < JWLR_FRAME_STATS_BUCKETS - 1; i++) {
+        bounds[i] = janet_wrap_number(jwlr_frame_stats_bounds_us[i] / 1000.0);
+    }
+
+    st = janet_struct_begin(4);
+    janet_struct_put(st, janet_ckeywordv("bounds-ms"),
+                     janet_wrap_tuple(janet_tuple_n(bounds, JWLR_FRAME_STATS_BUCKETS - 1)));
+    janet_struct_put(st, janet_ckeywordv("failed-commits"), janet_wrap_number((double)stats->failed_commits));
+    janet_struct_put(st, janet_ckeywordv("latency"), jwlr_frame_stats_hist_to_struct(&stats->latency));
+    janet_struct_put(st, janet_ckeywordv("commit"), jwlr_frame_stats_hist_to_struct(&stats->commit));
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+
+static Janet cfun_wlr_output_frame_stats_reset(int32_t argc, Janet *argv)
+{
+    struct wlr_output *output;
+
+    jwlr_output_frame_stats_t *stats;
+
+    janet_fixarity(argc, 1);
+
+    output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_output);
+    stats = jwlr_output_frame_stats_find(output);
+    if (stats) {
+        stats->failed_commits = 0;
+        memset(&stats->latency, 0, sizeof(stats->latency));
+        memset(&stats->commit, 0, sizeof(stats->commit));
+    }
+    return janet_wrap_nil();
+}
+
+
+static Janet cfun_wlr_scene_output_commit(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_output *scene_output;
+
+    janet_fixarity(argc, 1);
+
+    scene_output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_output);
+    return janet_wrap_boolean(jwlr_scene_output_commit_measured(scene_output));
+}
+
+
+static Janet cfun_wlr_scene_output_send_frame_done(int32_t argc, Janet *argv)
+{
+    struct wlr_scene_output *scene_output;
+    struct timespec *now;
+
+    janet_fixarity(argc, 2);
+
+    scene_output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_output);
+    now = janet_getabstract(argv, 1, jl_get_abstract_type_by_name(UTIL_MOD_NAME "/timespec"));
+
+    uint64_t trace_start = jwlr_trace_begin();
+    wlr_scene_output_send_frame_done(scene_output, now);
+    jwlr_trace_end("render", "frame-done", trace_start);
+    return janet_wrap_nil();
+}
+
+
+typedef struct {
+    int32_t interval_ms;
+} jwlr_frame_throttle_t;
+
+
+typedef struct {
+    struct wlr_scene_output *scene_output;
+    struct timespec *now;
+    pixman_region32_t covered;
+    jwlr_frame_throttle_t *throttle;
+    int occluded_count;
+} jwlr_visible_frame_done_t;
+
+
+/* When the last throttled frame-done was sent to a scene buffer. It's kept
+   per buffer, since disabled trees are walked once per output, and the
+   same buffer may be occluded on several outputs. */
+typedef struct {
+    struct wlr_addon addon;
+    struct timespec last_sent;
+} jwlr_throttled_frame_done_t;
+
+
+static void jwlr_throttled_frame_done_addon_destroy(struct wlr_addon *addon)
+{
+    jwlr_throttled_frame_done_t *throttled = wl_container_of(addon, throttled, addon);
+    wlr_addon_finish(&throttled->addon);
+    free(throttled);
+}
+
+static const struct wlr_addon_interface jwlr_throttled_frame_done_addon_impl = {
+    .name = "janetland-throttled-frame-done",
+    .destroy = jwlr_throttled_frame_done_addon_destroy,
+};
+
+
+static void jwlr_send_throttled_frame_done(struct wlr_scene_buffer *buffer, struct timespec *now,
+                                           jwlr_frame_throttle_t *throttle)
+{
+    jwlr_throttled_frame_done_t *throttled;
+    struct wlr_addon *addon = wlr_addon_find(&buffer->node.addons, NULL,
+                                             &jwlr_throttled_frame_done_addon_impl);
+
+    if (addon) {
+        throttled = wl_container_of(addon, throttled, addon);
+        int64_t elapsed_ms = (int64_t)(now->tv_sec - throttled->last_sent.tv_sec) * 1000 +
+            (now->tv_nsec - throttled->last_sent.tv_nsec) / 1000000;
+        if (elapsed_ms < throttle->interval_ms) {
+            return;
         }
-        *out = janet_wrap_array(kc_arr);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "modifiers")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(&keyboard->modifiers,
-                                                         &jwlr_at_wlr_keyboard_modifiers));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "data")) {
-        if (!(keyboard->data)) {
-            *out = janet_wrap_nil();
-            return 1;
+    } else {
+        throttled = malloc(sizeof(*throttled));
+        if (!throttled) {
+            /* Better to send too many than none at all */
+            wlr_scene_buffer_send_frame_done(buffer, now);
+            return;
         }
-        *out = janet_wrap_pointer(keyboard->data);
-        return 1;
+        wlr_addon_init(&throttled->addon, &buffer->node.addons, NULL,
+                       &jwlr_throttled_frame_done_addon_impl);
     }
 
-    return 0;
+    throttled->last_sent = *now;
+    wlr_scene_buffer_send_frame_done(buffer, now);
 }
 
 
-static int method_wlr_pointer_motion_event_get(void *p, Janet key, Janet *out)
+static void jwlr_send_throttled_frame_done_in_tree(struct wlr_scene_node *node, struct timespec *now,
+                                                   jwlr_frame_throttle_t *throttle)
 {
-    struct wlr_pointer_motion_event **event_p = (struct wlr_pointer_motion_event **)p;
-    struct wlr_pointer_motion_event *event = *event_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
+    if (WLR_SCENE_NODE_BUFFER == node->type) {
+        jwlr_send_throttled_frame_done(wlr_scene_buffer_from_node(node), now, throttle);
+    } else if (WLR_SCENE_NODE_TREE == node->type) {
+        struct wlr_scene_tree *tree = wl_container_of(node, tree, node);
+        struct wlr_scene_node *child;
+        wl_list_for_each(child, &tree->children, link) {
+            jwlr_send_throttled_frame_done_in_tree(child, now, throttle);
+        }
     }
+}
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
 
-    if (!janet_cstrcmp(kw, "pointer")) {
-        if (!(event->pointer)) {
-            *out = janet_wrap_nil();
-            return 1;
+static void jwlr_scene_buffer_get_size(struct wlr_scene_buffer *buffer, int *width, int *height)
+{
+    *width = buffer->dst_width;
+    *height = buffer->dst_height;
+    if ((0 == *width || 0 == *height) && buffer->buffer) {
+        *width = buffer->buffer->width;
+        *height = buffer->buffer->height;
+        if (buffer->transform & WL_OUTPUT_TRANSFORM_90) {
+            int tmp = *width;
+            *width = *height;
+            *height = tmp;
         }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
-        return 1;
     }
-    if (!janet_cstrcmp(kw, "time-msec")) {
-        /* uint32_t -> uint64_t */
-        *out = janet_wrap_u64(event->time_msec);
-        return 1;
+}
+
+
+/* Walks the nodes from top to bottom, accumulating the opaque regions in
+   layout coordinates, so that buffers completely covered by nodes above
+   them can be spotted. */
+static void jwlr_send_visible_frame_done(struct wlr_scene_node *node, int lx, int ly,
+                                         jwlr_visible_frame_done_t *state)
+{
+    if (!node->enabled) {
+        /* Buffers in disabled trees are never visible */
+        if (state->throttle) {
+            jwlr_send_throttled_frame_done_in_tree(node, state->now, state->throttle);
+        }
+        return;
     }
-    if (!janet_cstrcmp(kw, "delta-x")) {
-        *out = janet_wrap_number(event->delta_x);
-        return 1;
+
+    lx += node->x;
+    ly += node->y;
+
+    switch (node->type) {
+    case WLR_SCENE_NODE_TREE: {
+        struct wlr_scene_tree *tree = wl_container_of(node, tree, node);
+        struct wlr_scene_node *child;
+        wl_list_for_each_reverse(child, &tree->children, link) {
+            jwlr_send_visible_frame_done(child, lx, ly, state);
+        }
+        break;
     }
-    if (!janet_cstrcmp(kw, "delta-y")) {
-        *out = janet_wrap_number(event->delta_y);
-        return 1;
+    case WLR_SCENE_NODE_RECT: {
+        struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+        if (rect->color[3] >= 1.0f) {
+            pixman_region32_union_rect(&state->covered, &state->covered,
+                                       lx, ly, rect->width, rect->height);
+        }
+        break;
     }
-    if (!janet_cstrcmp(kw, "unaccel-dx")) {
-        *out = janet_wrap_number(event->unaccel_dx);
-        return 1;
+    case WLR_SCENE_NODE_BUFFER: {
+        struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+        int width, height;
+        pixman_region32_t visible;
+        int is_visible;
+
+        if (buffer->primary_output != state->scene_output) {
+            break;
+        }
+
+        jwlr_scene_buffer_get_size(buffer, &width, &height);
+        pixman_region32_init_rect(&visible, lx, ly, width, height);
+        pixman_region32_subtract(&visible, &visible, &state->covered);
+        is_visible = pixman_region32_not_empty(&visible);
+        pixman_region32_fini(&visible);
+
+        if (is_visible) {
+            wlr_scene_buffer_send_frame_done(buffer, state->now);
+        } else {
+            state->occluded_count++;
+            if (state->throttle) {
+                jwlr_send_throttled_frame_done(buffer, state->now, state->throttle);
+            }
+        }
+
+        if (pixman_region32_not_empty(&buffer->opaque_region)) {
+            pixman_region32_t opaque;
+            pixman_region32_init(&opaque);
+            pixman_region32_copy(&opaque, &buffer->opaque_region);
+            pixman_region32_translate(&opaque, lx, ly);
+            pixman_region32_union(&state->covered, &state->covered, &opaque);
+            pixman_region32_fini(&opaque);
+        }
+        break;
     }
-    if (!janet_cstrcmp(kw, "unaccel-dy")) {
-        *out = janet_wrap_number(event->unaccel_dy);
-        return 1;
+    default:
+        break;
     }
+}
 
-    return 0;
+
+static int jwlr_scene_output_send_frame_done_visible(struct wlr_scene_output *scene_output,
+                                                     struct timespec *now,
+                                                     jwlr_frame_throttle_t *throttle)
+{
+    jwlr_visible_frame_done_t state;
+    uint64_t trace_start = jwlr_trace_begin();
+
+    state.scene_output = scene_output;
+    state.now = now;
+    state.throttle = throttle;
+    state.occluded_count = 0;
+    pixman_region32_init(&state.covered);
+
+    jwlr_send_visible_frame_done(&scene_output->scene->tree.node, 0, 0, &state);
+    pixman_region32_fini(&state.covered);
+
+    jwlr_trace_end("render", "frame-done-visible", trace_start);
+
+    return state.occluded_count;
 }
 
 
-static int method_wlr_pointer_motion_absolute_event_get(void *p, Janet key, Janet *out)
+static Janet cfun_wlr_scene_output_send_frame_done_visible(int32_t argc, Janet *argv)
 {
-    struct wlr_pointer_motion_absolute_event **event_p = (struct wlr_pointer_motion_absolute_event **)p;
-    struct wlr_pointer_motion_absolute_event *event = *event_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
-    }
+    struct wlr_scene_output *scene_output;
+    struct timespec *now;
+    jwlr_frame_throttle_t *throttle = NULL;
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
+    janet_arity(argc, 2, 3);
 
-    if (!janet_cstrcmp(kw, "pointer")) {
-        if (!(event->pointer)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "time-msec")) {
-        /* uint32_t -> uint64_t */
-        *out = janet_wrap_u64(event->time_msec);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "x")) {
-        *out = janet_wrap_number(event->x);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "y")) {
-        *out = janet_wrap_number(event->y);
-        return 1;
+    scene_output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_output);
+    now = janet_getabstract(argv, 1, jl_get_abstract_type_by_name(UTIL_MOD_NAME "/timespec"));
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        throttle = janet_getabstract(argv, 2, &jwlr_at_frame_throttle);
     }
 
-    return 0;
+    return janet_wrap_integer(jwlr_scene_output_send_frame_done_visible(scene_output, now, throttle));
 }
 
 
-static int method_wlr_pointer_button_event_get(void *p, Janet key, Janet *out)
+static int method_frame_throttle_get(void *p, Janet key, Janet *out)
 {
-    struct wlr_pointer_button_event **event_p = (struct wlr_pointer_button_event **)p;
-    struct wlr_pointer_button_event *event = *event_p;
-    
+    jwlr_frame_throttle_t *throttle = (jwlr_frame_throttle_t *)p;
+
     if (!janet_checktype(key, JANET_KEYWORD)) {
         janet_panicf("expected keyword, got %v", key);
     }
 
     const uint8_t *kw = janet_unwrap_keyword(key);
-
-    if (!janet_cstrcmp(kw, "pointer")) {
-        if (!(event->pointer)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "time-msec")) {
-        /* uint32_t -> uint64_t */
-        *out = janet_wrap_u64(event->time_msec);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "button")) {
-        /* uint32_t -> uint64_t */
-        *out = janet_wrap_u64(event->button);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "state")) {
-        if (event->state >= __WLR_BUTTON_STATE_DEFS_COUNT) {
-            janet_panicf("unknown button state from wlroots pointer button event: %d", event->state);
-        }
-        *out = janet_ckeywordv(wlr_button_state_defs[event->state].name);
+    if (!janet_cstrcmp(kw, "interval")) {
+        *out = janet_wrap_integer(throttle->interval_ms);
         return 1;
     }
 
@@ -3210,170 +7332,191 @@ static int method_wlr_pointer_button_event_get(void *p, Janet key, Janet *out)
 }
 
 
-static int method_wlr_pointer_axis_event_get(void *p, Janet key, Janet *out)
+static Janet cfun_wlr_frame_throttle_create(int32_t argc, Janet *argv)
 {
-    struct wlr_pointer_axis_event **event_p = (struct wlr_pointer_axis_event **)p;
-    struct wlr_pointer_axis_event *event = *event_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
-    }
+    jwlr_frame_throttle_t *throttle;
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
+    janet_arity(argc, 0, 1);
 
-    if (!janet_cstrcmp(kw, "pointer")) {
-        if (!(event->pointer)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->pointer, &jwlr_at_wlr_pointer));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "time-msec")) {
-        /* uint32_t -> uint64_t */
-        *out = janet_wrap_u64(event->time_msec);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "source")) {
-        if (event->source >= __WLR_AXIS_SOURCE_DEFS_COUNT) {
-            janet_panicf("unknown axis source from wlroots pointer axis event: %d", event->source);
-        }
-        *out = janet_ckeywordv(wlr_axis_source_defs[event->source].name);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "orientation")) {
-        if (event->orientation >= __WLR_AXIS_ORIENTATION_DEFS_COUNT) {
-            janet_panicf("unknown axis orientation from wlroots pointer axis event: %d", event->orientation);
-        }
-        *out = janet_ckeywordv(wlr_axis_orientation_defs[event->orientation].name);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "delta")) {
-        *out = janet_wrap_number(event->delta);
-        return 1;
+    throttle = janet_abstract(&jwlr_at_frame_throttle, sizeof(*throttle));
+    throttle->interval_ms = janet_optnat(argv, argc, 0, 1000);
+    return janet_wrap_abstract(throttle);
+}
+
+
+/* Handles output frames without entering Janet, unless a hook is given.
+   The handler stays rooted until it's destroyed, or the output goes away. */
+typedef struct {
+    struct wlr_scene *scene;
+    struct wlr_output *output;
+    struct wlr_scene_output *scene_output;
+    jwlr_frame_throttle_t *throttle;
+    JanetFunction *hook;
+    struct wl_listener frame;
+    struct wl_listener output_destroy;
+    struct wl_listener scene_output_destroy;
+    int active;
+} jwlr_output_frame_handler_t;
+
+
+static void jwlr_output_frame_handler_release(jwlr_output_frame_handler_t *handler)
+{
+    if (!handler->active) {
+        return;
     }
-    if (!janet_cstrcmp(kw, "delta-discrete")) {
-        *out = janet_wrap_integer(event->delta_discrete);
-        return 1;
+    handler->active = 0;
+    wl_list_remove(&handler->frame.link);
+    wl_list_remove(&handler->output_destroy.link);
+    if (handler->scene_output) {
+        wl_list_remove(&handler->scene_output_destroy.link);
+        handler->scene_output = NULL;
     }
+    janet_gcunroot(janet_wrap_abstract(handler));
+}
 
-    return 0;
+
+static void jwlr_output_frame_handler_handle_scene_output_destroy(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_output_frame_handler_t *handler = wl_container_of(listener, handler, scene_output_destroy);
+    wl_list_remove(&handler->scene_output_destroy.link);
+    handler->scene_output = NULL;
 }
 
 
-static int method_wlr_seat_pointer_state_get(void *p, Janet key, Janet *out)
+static void jwlr_output_frame_handler_handle_output_destroy(struct wl_listener *listener, void *data)
 {
-    struct wlr_seat_pointer_state **state_p = (struct wlr_seat_pointer_state **)p;
-    struct wlr_seat_pointer_state *state = *state_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
-    }
+    (void)data;
+    jwlr_output_frame_handler_t *handler = wl_container_of(listener, handler, output_destroy);
+    jwlr_output_frame_handler_release(handler);
+}
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
 
-    struct wl_signal **signal_p = get_abstract_struct_signal_member(state, kw, wlr_seat_pointer_state_signal_offsets);
-    if (signal_p) {
-        *out = janet_wrap_abstract(signal_p);
-        return 1;
-    }
+static void jwlr_output_frame_handler_handle_frame(struct wl_listener *listener, void *data)
+{
+    (void)data;
+    jwlr_output_frame_handler_t *handler = wl_container_of(listener, handler, frame);
+    struct timespec now;
+    uint64_t frame_trace_start = jwlr_trace_begin();
+    uint64_t trace_start;
 
-    if (!janet_cstrcmp(kw, "seat")) {
-        if (!(state->seat)) {
-            *out = janet_wrap_nil();
-            return 1;
+    if (!handler->scene_output) {
+        /* The scene output may be created after the handler, e.g. when the
+           output gets added to an output layout */
+        handler->scene_output = wlr_scene_get_scene_output(handler->scene, handler->output);
+        if (!handler->scene_output) {
+            return;
         }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->seat, &jwlr_at_wlr_seat));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "focused-client")) {
-        if (!(state->focused_client)) {
-            *out = janet_wrap_nil();
-            return 1;
+        handler->scene_output_destroy.notify = jwlr_output_frame_handler_handle_scene_output_destroy;
+        wl_signal_add(&handler->scene_output->events.destroy, &handler->scene_output_destroy);
+    }
+
+    if (handler->hook) {
+        Janet argv[] = {
+            janet_wrap_abstract(jl_pointer_to_abs_obj(handler->output, &jwlr_at_wlr_output)),
+            janet_wrap_abstract(jl_pointer_to_abs_obj(handler->scene_output, &jwlr_at_wlr_scene_output)),
+        };
+        Janet ret = janet_wrap_nil();
+        JanetFiber *fiber = NULL;
+
+        trace_start = jwlr_trace_begin();
+        int locked = janet_gclock();
+        int sig = janet_pcall(handler->hook, 2, argv, &ret, &fiber);
+        janet_gcunlock(locked);
+        jwlr_trace_end("callback", "output-frame-hook", trace_start);
+        if (JANET_SIGNAL_OK != sig) {
+            janet_stacktrace(fiber, ret);
         }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_client, &jwlr_at_wlr_seat_client));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "focused-surface")) {
-        if (!(state->focused_surface)) {
-            *out = janet_wrap_nil();
-            return 1;
+        if (!handler->active || !handler->scene_output) {
+            /* Destroyed by the hook */
+            return;
         }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_surface, &jwlr_at_wlr_surface));
-        return 1;
     }
-    if (!janet_cstrcmp(kw, "sx")) {
-        *out = janet_wrap_number(state->sx);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "sy")) {
-        *out = janet_wrap_number(state->sy);
-        return 1;
+
+    jwlr_scene_output_commit_measured(handler->scene_output);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (handler->throttle) {
+        jwlr_scene_output_send_frame_done_visible(handler->scene_output, &now, handler->throttle);
+    } else {
+        trace_start = jwlr_trace_begin();
+        wlr_scene_output_send_frame_done(handler->scene_output, &now);
+        jwlr_trace_end("render", "frame-done", trace_start);
     }
 
-    return 0;
+    jwlr_trace_end("output", "output-frame", frame_trace_start);
 }
 
 
-static int method_wlr_seat_keyboard_state_get(void *p, Janet key, Janet *out)
+static int method_output_frame_handler_gcmark(void *p, size_t len)
 {
-    struct wlr_seat_keyboard_state **state_p = (struct wlr_seat_keyboard_state **)p;
-    struct wlr_seat_keyboard_state *state = *state_p;
-    
-    if (!janet_checktype(key, JANET_KEYWORD)) {
-        janet_panicf("expected keyword, got %v", key);
+    (void)len;
+    jwlr_output_frame_handler_t *handler = (jwlr_output_frame_handler_t *)p;
+
+    if (handler->hook) {
+        janet_mark(janet_wrap_function(handler->hook));
     }
+    if (handler->throttle) {
+        janet_mark(janet_wrap_abstract(handler->throttle));
+    }
+    return 0;
+}
 
-    const uint8_t *kw = janet_unwrap_keyword(key);
 
-    struct wl_signal **signal_p = get_abstract_struct_signal_member(state, kw,
-                                                                    wlr_seat_keyboard_state_signal_offsets);
-    if (signal_p) {
-        *out = janet_wrap_abstract(signal_p);
-        return 1;
-    }
+static Janet cfun_wlr_output_frame_handler_create(int32_t argc, Janet *argv)
+{
+    struct wlr_scene *scene;
+    struct wlr_output *output;
+    JanetFunction *hook = NULL;
+    jwlr_frame_throttle_t *throttle = NULL;
 
-    if (!janet_cstrcmp(kw, "seat")) {
-        if (!(state->seat)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->seat, &jwlr_at_wlr_seat));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "keyboard")) {
-        if (!(state->keyboard)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->keyboard, &jwlr_at_wlr_keyboard));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "focused-client")) {
-        if (!(state->focused_client)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_client, &jwlr_at_wlr_seat_client));
-        return 1;
+    jwlr_output_frame_handler_t *handler;
+
+    janet_arity(argc, 2, 4);
+
+    scene = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene);
+    output = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_output);
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        hook = janet_getfunction(argv, 2);
     }
-    if (!janet_cstrcmp(kw, "focused-surface")) {
-        if (!(state->focused_surface)) {
-            *out = janet_wrap_nil();
-            return 1;
-        }
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(state->focused_surface, &jwlr_at_wlr_surface));
-        return 1;
+    if (argc > 3 && !janet_checktype(argv[3], JANET_NIL)) {
+        throttle = janet_getabstract(argv, 3, &jwlr_at_frame_throttle);
     }
 
-    return 0;
+    handler = janet_abstract(&jwlr_at_output_frame_handler, sizeof(*handler));
+    handler->scene = scene;
+    handler->output = output;
+    handler->scene_output = NULL;
+    handler->throttle = throttle;
+    handler->hook = hook;
+    handler->active = 1;
+
+    handler->frame.notify = jwlr_output_frame_handler_handle_frame;
+    wl_signal_add(&output->events.frame, &handler->frame);
+    handler->output_destroy.notify = jwlr_output_frame_handler_handle_output_destroy;
+    wl_signal_add(&output->events.destroy, &handler->output_destroy);
+
+    janet_gcroot(janet_wrap_abstract(handler));
+    return janet_wrap_abstract(handler);
 }
 
 
-static int method_wlr_seat_pointer_request_set_cursor_event_get(void *p, Janet key, Janet *out)
+static Janet cfun_wlr_output_frame_handler_destroy(int32_t argc, Janet *argv)
 {
-    struct wlr_seat_pointer_request_set_cursor_event **event_p = (struct wlr_seat_pointer_request_set_cursor_event **)p;
-    struct wlr_seat_pointer_request_set_cursor_event *event = *event_p;
+    jwlr_output_frame_handler_t *handler;
+
+    janet_fixarity(argc, 1);
+
+    handler = janet_getabstract(argv, 0, &jwlr_at_output_frame_handler);
+    jwlr_output_frame_handler_release(handler);
+    return janet_wrap_nil();
+}
+
+
+static int method_wlr_output_event_commit_get(void *p, Janet key, Janet *out)
+{
+    struct wlr_output_event_commit **event_p = (struct wlr_output_event_commit **)p;
+    struct wlr_output_event_commit *event = *event_p;
 
     if (!janet_checktype(key, JANET_KEYWORD)) {
         janet_panicf("expected keyword, got %v", key);
@@ -3381,25 +7524,16 @@ static int method_wlr_seat_pointer_request_set_cursor_event_get(void *p, Janet k
 
     const uint8_t *kw = janet_unwrap_keyword(key);
 
-    if (!janet_cstrcmp(kw, "seat-client")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->seat_client, &jwlr_at_wlr_seat_client));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "surface")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->surface, &jwlr_at_wlr_surface));
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "serial")) {
-        /* XXX: uint32_t -> int32_t conversion */
-        *out = janet_wrap_integer(event->serial);
-        return 1;
-    }
-    if (!janet_cstrcmp(kw, "hotspot-x")) {
-        *out = janet_wrap_integer(event->hotspot_x);
+    if (!janet_cstrcmp(kw, "output")) {
+        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->output, &jwlr_at_wlr_output));
         return 1;
     }
-    if (!janet_cstrcmp(kw, "hotspot-y")) {
-        *out = janet_wrap_integer(event->hotspot_y);
+    if (!janet_cstrcmp(kw, "buffer")) {
+        if (event->buffer) {
+            *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->buffer, &jwlr_at_wlr_buffer));
+        } else {
+            *out = janet_wrap_nil();
+        }
         return 1;
     }
 
@@ -3407,10 +7541,10 @@ static int method_wlr_seat_pointer_request_set_cursor_event_get(void *p, Janet k
 }
 
 
-static int method_wlr_seat_request_set_selection_event_get(void *p, Janet key, Janet *out)
+static int method_wlr_buffer_get(void *p, Janet key, Janet *out)
 {
-    struct wlr_seat_request_set_selection_event **event_p = (struct wlr_seat_request_set_selection_event **)p;
-    struct wlr_seat_request_set_selection_event *event = *event_p;
+    struct wlr_buffer **buffer_p = (struct wlr_buffer **)p;
+    struct wlr_buffer *buffer = *buffer_p;
 
     if (!janet_checktype(key, JANET_KEYWORD)) {
         janet_panicf("expected keyword, got %v", key);
@@ -3418,13 +7552,12 @@ static int method_wlr_seat_request_set_selection_event_get(void *p, Janet key, J
 
     const uint8_t *kw = janet_unwrap_keyword(key);
 
-    if (!janet_cstrcmp(kw, "source")) {
-        *out = janet_wrap_abstract(jl_pointer_to_abs_obj(event->source, &jwlr_at_wlr_data_source));
+    if (!janet_cstrcmp(kw, "width")) {
+        *out = janet_wrap_integer(buffer->width);
         return 1;
     }
-    if (!janet_cstrcmp(kw, "serial")) {
-        /* XXX: uint32_t -> int32_t conversion */
-        *out = janet_wrap_integer(event->serial);
+    if (!janet_cstrcmp(kw, "height")) {
+        *out = janet_wrap_integer(buffer->height);
         return 1;
     }
 
@@ -3432,48 +7565,61 @@ static int method_wlr_seat_request_set_selection_event_get(void *p, Janet key, J
 }
 
 
-static Janet cfun_wlr_scene_get_scene_output(int32_t argc, Janet *argv)
+static Janet cfun_wlr_renderer_read_pixels(int32_t argc, Janet *argv)
 {
-    struct wlr_scene *scene;
-    struct wlr_output *output;
-
-    struct wlr_scene_output *scene_output;
+    struct wlr_renderer *renderer;
+    struct wlr_buffer *buffer;
+    struct wlr_box box;
 
-    janet_fixarity(argc, 2);
+    int32_t stride;
+    JanetBuffer *pixels;
+    bool ret;
 
-    scene = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene);
-    output = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_output);
+    janet_arity(argc, 2, 3);
 
-    scene_output = wlr_scene_get_scene_output(scene, output);
-    if (!scene_output) {
-        janet_panic("failed to create wlroots scene output object");
+    renderer = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_renderer);
+    if (janet_checkabstract(argv[1], &jwlr_at_shm_buffer)) {
+        buffer = &(jwlr_get_shm_buffer(argv, 1)->base);
+    } else {
+        buffer = jl_get_abs_obj_pointer(argv, 1, &jwlr_at_wlr_buffer);
     }
-    return janet_wrap_abstract(jl_pointer_to_abs_obj(scene_output, &jwlr_at_wlr_scene_output));
-}
 
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        struct wlr_box *src_box = janet_getabstract(argv, 2, &jwlr_at_box);
+        box = *src_box;
+    } else {
+        box.x = 0;
+        box.y = 0;
+        box.width = buffer->width;
+        box.height = buffer->height;
+    }
+    if (box.x < 0 || box.y < 0 || box.width <= 0 || box.height <= 0
+            || box.x + box.width > buffer->width || box.y + box.height > buffer->height) {
+        janet_panicf("invalid box for a %dx%d buffer", buffer->width, buffer->height);
+    }
 
-static Janet cfun_wlr_scene_output_commit(int32_t argc, Janet *argv)
-{
-    struct wlr_scene_output *scene_output;
+    stride = box.width * 4;
+    pixels = janet_buffer(stride * box.height);
 
-    janet_fixarity(argc, 1);
+    if (!wlr_renderer_begin_with_buffer(renderer, buffer)) {
+        janet_panic("failed to bind buffer to renderer");
+    }
+    ret = wlr_renderer_read_pixels(renderer, DRM_FORMAT_ARGB8888, stride,
+                                   box.width, box.height, box.x, box.y, 0, 0,
+                                   pixels->data);
+    wlr_renderer_end(renderer);
 
-    scene_output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_output);
-    return janet_wrap_boolean(wlr_scene_output_commit(scene_output));
+    if (!ret) {
+        return janet_wrap_nil();
+    }
+    pixels->count = stride * box.height;
+    return janet_wrap_buffer(pixels);
 }
 
 
-static Janet cfun_wlr_scene_output_send_frame_done(int32_t argc, Janet *argv)
+static Janet cfun_wlr_trace_attach(int32_t argc, Janet *argv)
 {
-    struct wlr_scene_output *scene_output;
-    struct timespec *now;
-
-    janet_fixarity(argc, 2);
-
-    scene_output = jl_get_abs_obj_pointer(argv, 0, &jwlr_at_wlr_scene_output);
-    now = janet_getabstract(argv, 1, jl_get_abstract_type_by_name(UTIL_MOD_NAME "/timespec"));
-
-    wlr_scene_output_send_frame_done(scene_output, now);
+    jl_trace_attach(&jwlr_trace_ring, &jwlr_trace_ring_value, argc, argv);
     return janet_wrap_nil();
 }
 
@@ -4205,6 +8351,16 @@ static JanetReg cfuns[] = {
         "(" MOD_NAME "/wlr-backend-autocreate wl-display)\n\n"
         "Creates a wlroots backend object."
     },
+    {
+        "wlr-headless-backend-create", cfun_wlr_headless_backend_create,
+        "(" MOD_NAME "/wlr-headless-backend-create wl-display)\n\n"
+        "Creates a headless wlroots backend object, which needs no GPU or display."
+    },
+    {
+        "wlr-headless-add-output", cfun_wlr_headless_add_output,
+        "(" MOD_NAME "/wlr-headless-add-output wlr-backend width height)\n\n"
+        "Adds a virtual output to a headless backend."
+    },
     {
         "wlr-backend-destroy", cfun_wlr_backend_destroy,
         "(" MOD_NAME "/wlr-backend-destroy wlr-backend)\n\n"
@@ -4220,6 +8376,19 @@ static JanetReg cfuns[] = {
         "(" MOD_NAME "/wlr-renderer-autocreate wlr-backend)\n\n"
         "Creates a wlroots renderer object."
     },
+    {
+        "wlr-pixman-renderer-create", cfun_wlr_pixman_renderer_create,
+        "(" MOD_NAME "/wlr-pixman-renderer-create)\n\n"
+        "Creates a CPU-only pixman renderer object."
+    },
+    {
+        "wlr-renderer-read-pixels", cfun_wlr_renderer_read_pixels,
+        "(" MOD_NAME "/wlr-renderer-read-pixels wlr-renderer buffer &opt box)\n\n"
+        "Reads the pixels in box (defaults to the whole buffer) from a wlr-buffer "
+        "or shm-buffer, in ARGB8888 format. Committed output buffers can be found "
+        "in the wlr-output-event-commit events of an output's :events.commit signal. "
+        "Returns a new buffer, or nil on failure."
+    },
     {
         "wlr-renderer-init-wl-display", cfun_wlr_renderer_init_wl_display,
         "(" MOD_NAME "/wlr-renderer-init-wl-display wlr-renderer wl-display)\n\n"
@@ -4290,6 +8459,345 @@ static JanetReg cfuns[] = {
         "(" MOD_NAME "/wlr-scene-node-lower-to-bottom wlr-scene-node)\n\n"
         "Moves the node below all of its sibling nodes."
     },
+    {
+        "wlr-scene-node-batch", cfun_wlr_scene_node_batch,
+        "(" MOD_NAME "/wlr-scene-node-batch ops)\n\n"
+        "Applies a list of scene node operations in one call. Each operation is "
+        "a tuple in the form of [:set-position node x y], [:set-enabled node enabled], "
+        "[:raise-to-top node], [:lower-to-bottom node], [:place-above node sibling], "
+        "[:place-below node sibling] or [:reparent node new-parent-tree]. "
+        "All operations are validated before any of them is applied."
+    },
+    {
+        "wlr-scene-tree-snapshot", cfun_wlr_scene_tree_snapshot,
+        "(" MOD_NAME "/wlr-scene-tree-snapshot wlr-scene-tree)\n\n"
+        "Returns the whole subtree in depth-first order, as a struct of parallel "
+        "arrays: :nodes (raw node pointers), :parents (index of the parent node, "
+        "-1 for the root), :types, :x, :y, :enabled and :data (raw pointers)."
+    },
+    {
+        "wlr-scene-node-find-ancestor-data", cfun_wlr_scene_node_find_ancestor_data,
+        "(" MOD_NAME "/wlr-scene-node-find-ancestor-data wlr-scene-node &opt data-type)\n\n"
+        "Finds the closest ancestor tree of a node that has non-NULL data. Returns "
+        "[tree data], or nil if there's no such tree. Data-type can be nil (returns "
+        "a raw pointer), :table, or the name of an abstract type."
+    },
+    {
+        "wlr-view-index-create", cfun_wlr_view_index_create,
+        "(" MOD_NAME "/wlr-view-index-create &opt cell-size)\n\n"
+        "Creates a spatial index for looking up views by layout coordinates. "
+        "Positions are updated automatically by wlr-scene-node-set-position, "
+        "wlr-scene-node-reparent and wlr-scene-node-batch."
+    },
+    {
+        "wlr-view-index-add", cfun_wlr_view_index_add,
+        "(" MOD_NAME "/wlr-view-index-add view-index wlr-scene-node value width height)\n\n"
+        "Adds a scene node to the index, or updates an existing one. Value is "
+        "returned by wlr-view-index-at when the node is hit. The node is removed "
+        "automatically when it's destroyed."
+    },
+    {
+        "wlr-view-index-set-size", cfun_wlr_view_index_set_size,
+        "(" MOD_NAME "/wlr-view-index-set-size view-index wlr-scene-node width height)\n\n"
+        "Updates the size of a node's bounding box in the index."
+    },
+    {
+        "wlr-view-index-update", cfun_wlr_view_index_update,
+        "(" MOD_NAME "/wlr-view-index-update wlr-scene-node)\n\n"
+        "Refreshes the index entries of a node and its descendants, in all indices. "
+        "Only needed when their positions are changed by other means."
+    },
+    {
+        "wlr-view-index-remove", cfun_wlr_view_index_remove,
+        "(" MOD_NAME "/wlr-view-index-remove view-index wlr-scene-node)\n\n"
+        "Removes a node from the index. Returns false if it's not found."
+    },
+    {
+        "wlr-view-index-at", cfun_wlr_view_index_at,
+        "(" MOD_NAME "/wlr-view-index-at view-index lx ly)\n\n"
+        "Finds the topmost enabled view at the given layout coordinates. Returns "
+        "[value node sx sy], where node is the scene node at that point, or nil."
+    },
+    {
+        "wlr-workspace-create", cfun_wlr_workspace_create,
+        "(" MOD_NAME "/wlr-workspace-create parent-tree &opt hidden-frame-interval)\n\n"
+        "Creates a hidden workspace, as a new scene tree under parent-tree. Clients "
+        "on hidden workspaces receive frame events at most once every "
+        "hidden-frame-interval milliseconds (defaults to 1000)."
+    },
+    {
+        "wlr-workspace-destroy", cfun_wlr_workspace_destroy,
+        "(" MOD_NAME "/wlr-workspace-destroy workspace)\n\n"
+        "Destroys the workspace's scene tree, and all the nodes in it."
+    },
+    {
+        "wlr-workspace-add-view", cfun_wlr_workspace_add_view,
+        "(" MOD_NAME "/wlr-workspace-add-view workspace wlr-scene-node value)\n\n"
+        "Moves a view's scene node into the workspace. Value is what (workspace :views) "
+        "returns for this view. (workspace :views) lists them bottom to top, in the "
+        "stacking order of the workspace tree. A view can only be in one workspace, so it's removed from "
+        "its previous one, if any. The view is removed automatically when the node is destroyed."
+    },
+    {
+        "wlr-workspace-remove-view", cfun_wlr_workspace_remove_view,
+        "(" MOD_NAME "/wlr-workspace-remove-view workspace wlr-scene-node)\n\n"
+        "Stops tracking a view in the workspace. Its scene node is not moved. "
+        "Returns false if the view is not found."
+    },
+    {
+        "wlr-workspace-switch", cfun_wlr_workspace_switch,
+        "(" MOD_NAME "/wlr-workspace-switch from to)\n\n"
+        "Hides workspace from (can be nil) and shows workspace to. The cost does not "
+        "depend on the number of views."
+    },
+    {
+        "wlr-workspace-send-frame-done", cfun_wlr_workspace_send_frame_done,
+        "(" MOD_NAME "/wlr-workspace-send-frame-done workspace timespec)\n\n"
+        "Sends frame events to the clients on a hidden workspace, if its frame interval "
+        "has passed. Meant to be called in output frame handlers. Returns true if "
+        "events were sent."
+    },
+    {
+        "wlr-scene-rect-create", cfun_wlr_scene_rect_create,
+        "(" MOD_NAME "/wlr-scene-rect-create parent width height color)\n\n"
+        "Creates a solid-colored rect node. Color is in the form of [r g b a]."
+    },
+    {
+        "wlr-scene-rect-set-size", cfun_wlr_scene_rect_set_size,
+        "(" MOD_NAME "/wlr-scene-rect-set-size wlr-scene-rect width height)\n\n"
+        "Changes the size of a rect node."
+    },
+    {
+        "wlr-scene-rect-set-color", cfun_wlr_scene_rect_set_color,
+        "(" MOD_NAME "/wlr-scene-rect-set-color wlr-scene-rect color)\n\n"
+        "Changes the color of a rect node. Color is in the form of [r g b a]."
+    },
+    {
+        "wlr-scene-rect-from-node", cfun_wlr_scene_rect_from_node,
+        "(" MOD_NAME "/wlr-scene-rect-from-node wlr-scene-node)\n\n"
+        "Gets the rect object from a scene node."
+    },
+    {
+        "wlr-scene-rect-set-border", cfun_wlr_scene_rect_set_border,
+        "(" MOD_NAME "/wlr-scene-rect-set-border rects box border-width &opt color)\n\n"
+        "Places four rects, in the form of [top right bottom left], around box "
+        "as borders of border-width, and optionally changes their color, in one call."
+    },
+    {
+        "wlr-shm-buffer-create", cfun_wlr_shm_buffer_create,
+        "(" MOD_NAME "/wlr-shm-buffer-create width height)\n\n"
+        "Creates an ARGB8888 buffer in shared memory, filled with zeros. Draw into it "
+        "with wlr-shm-buffer-write or wlr-shm-buffer-write-rect."
+    },
+    {
+        "wlr-shm-buffer-write", cfun_wlr_shm_buffer_write,
+        "(" MOD_NAME "/wlr-shm-buffer-write shm-buffer bytes &opt offset)\n\n"
+        "Copies bytes into the pixel data of shm-buffer, starting at offset, which "
+        "defaults to 0. Rows are (shm-buffer :stride) bytes apart."
+    },
+    {
+        "wlr-shm-buffer-write-rect", cfun_wlr_shm_buffer_write_rect,
+        "(" MOD_NAME "/wlr-shm-buffer-write-rect shm-buffer x y width height src &opt src-stride)\n\n"
+        "Copies a width x height rect of ARGB8888 pixels from src into shm-buffer at "
+        "(x, y). Rows in src are src-stride bytes apart, which defaults to width * 4. "
+        "Meant to be paired with the damage box of wlr-scene-buffer-set-buffer-with-damage."
+    },
+    {
+        "wlr-shm-buffer-read", cfun_wlr_shm_buffer_read,
+        "(" MOD_NAME "/wlr-shm-buffer-read shm-buffer &opt offset len)\n\n"
+        "Returns a copy of len bytes of the pixel data of shm-buffer, starting at "
+        "offset. Copies everything from offset to the end if len is nil."
+    },
+    {
+        "wlr-shm-buffer-destroy", cfun_wlr_shm_buffer_destroy,
+        "(" MOD_NAME "/wlr-shm-buffer-destroy shm-buffer)\n\n"
+        "Releases an shm buffer. The memory is freed once wlroots stops using it."
+    },
+    {
+        "wlr-scene-buffer-create", cfun_wlr_scene_buffer_create,
+        "(" MOD_NAME "/wlr-scene-buffer-create parent shm-buffer)\n\n"
+        "Creates a scene node displaying shm-buffer, which can be nil."
+    },
+    {
+        "wlr-scene-buffer-set-buffer-with-damage", cfun_wlr_scene_buffer_set_buffer_with_damage,
+        "(" MOD_NAME "/wlr-scene-buffer-set-buffer-with-damage wlr-scene-buffer shm-buffer &opt damage-box)\n\n"
+        "Sets the buffer of a scene buffer node, and marks damage-box, in buffer-local "
+        "coordinates, as changed. The whole buffer is damaged if damage-box is nil. "
+        "Damage-box is ignored when shm-buffer is nil. "
+        "Can be called with the same shm-buffer after drawing into it."
+    },
+    {
+        "wlr-animator-create", cfun_wlr_animator_create,
+        "(" MOD_NAME "/wlr-animator-create)\n\n"
+        "Creates an animator, which advances scene node animations on output frames."
+    },
+    {
+        "wlr-animator-destroy", cfun_wlr_animator_destroy,
+        "(" MOD_NAME "/wlr-animator-destroy animator)\n\n"
+        "Cancels all animations, and detaches the animator from all outputs."
+    },
+    {
+        "wlr-animator-attach-output", cfun_wlr_animator_attach_output,
+        "(" MOD_NAME "/wlr-animator-attach-output animator wlr-output)\n\n"
+        "Advances the animations on every frame of wlr-output."
+    },
+    {
+        "wlr-animator-animate", cfun_wlr_animator_animate,
+        "(" MOD_NAME "/wlr-animator-animate animator wlr-scene-node property to-x to-y duration &opt easing on-done)\n\n"
+        "Animates the :position or :size (rect and buffer nodes only) of a node, "
+        "from the current value to [to-x to-y], in duration milliseconds. Easing "
+        "can be :linear, :ease-in, :ease-out (the default) or :ease-in-out. "
+        "(on-done finished) is called when the animation ends, with finished set "
+        "to false if it's cancelled or replaced by another animation."
+    },
+    {
+        "wlr-animator-cancel", cfun_wlr_animator_cancel,
+        "(" MOD_NAME "/wlr-animator-cancel animator wlr-scene-node &opt property)\n\n"
+        "Cancels the animations of a node, leaving it in the current state. "
+        "Returns the number of cancelled animations."
+    },
+    {
+        "wlr-animator-tick", cfun_wlr_animator_tick,
+        "(" MOD_NAME "/wlr-animator-tick animator)\n\n"
+        "Advances the animations manually, e.g. right before committing a scene "
+        "output. Returns true if there are still running animations."
+    },
+    {
+        "wlr-scene-output-send-frame-done-visible", cfun_wlr_scene_output_send_frame_done_visible,
+        "(" MOD_NAME "/wlr-scene-output-send-frame-done-visible wlr-scene-output timespec &opt throttle)\n\n"
+        "Like wlr-scene-output-send-frame-done, but skips buffers that are completely "
+        "covered by opaque nodes above them, or that live in disabled trees. When a "
+        "frame throttle is given, each of those buffers still receives frame-done "
+        "events, at most once per the throttle's interval, however many outputs "
+        "it's hidden on. Returns the number of occluded buffers."
+    },
+    {
+        "wlr-frame-throttle-create", cfun_wlr_frame_throttle_create,
+        "(" MOD_NAME "/wlr-frame-throttle-create &opt interval-ms)\n\n"
+        "Creates a frame throttle for occluded buffers, to be used with "
+        "wlr-scene-output-send-frame-done-visible. Interval-ms defaults to 1000."
+    },
+    {
+        "wlr-output-frame-handler-create", cfun_wlr_output_frame_handler_create,
+        "(" MOD_NAME "/wlr-output-frame-handler-create wlr-scene wlr-output &opt hook throttle)\n\n"
+        "Handles the frame events of wlr-output natively, by committing its scene "
+        "output and sending frame-done events. (hook wlr-output wlr-scene-output) is "
+        "called before the commit, if given. When a frame throttle is given, frame-done "
+        "events are sent as in wlr-scene-output-send-frame-done-visible. The handler "
+        "goes away with the output."
+    },
+    {
+        "wlr-output-frame-handler-destroy", cfun_wlr_output_frame_handler_destroy,
+        "(" MOD_NAME "/wlr-output-frame-handler-destroy handler)\n\n"
+        "Stops handling the frame events."
+    },
+    {
+        "wlr-virtual-keyboard-create", cfun_wlr_virtual_keyboard_create,
+        "(" MOD_NAME "/wlr-virtual-keyboard-create wlr-backend &opt name)\n\n"
+        "Creates a virtual keyboard, and announces it through the :events.new-input "
+        "signal of wlr-backend."
+    },
+    {
+        "wlr-virtual-pointer-create", cfun_wlr_virtual_pointer_create,
+        "(" MOD_NAME "/wlr-virtual-pointer-create wlr-backend &opt name)\n\n"
+        "Creates a virtual pointer, and announces it through the :events.new-input "
+        "signal of wlr-backend."
+    },
+    {
+        "wlr-virtual-input-destroy", cfun_wlr_virtual_input_destroy,
+        "(" MOD_NAME "/wlr-virtual-input-destroy virtual-input)\n\n"
+        "Destroys a virtual input device, firing its destroy signal. Virtual input "
+        "devices are never garbage collected before this is called."
+    },
+    {
+        "wlr-virtual-input-emit", cfun_wlr_virtual_input_emit,
+        "(" MOD_NAME "/wlr-virtual-input-emit virtual-input event-type & args)\n\n"
+        "Emits an event from a virtual input device. Event types and their arguments:\n\n"
+        "* :motion dx dy &opt time-msec\n"
+        "* :motion-absolute x y &opt time-msec (x and y are in [0, 1])\n"
+        "* :button button state &opt time-msec\n"
+        "* :axis orientation delta &opt delta-discrete source time-msec\n"
+        "* :frame\n"
+        "* :key keycode state &opt time-msec\n\n"
+        "Time-msec defaults to the current monotonic time."
+    },
+    {
+        "wlr-virtual-input-emit-batch", cfun_wlr_virtual_input_emit_batch,
+        "(" MOD_NAME "/wlr-virtual-input-emit-batch virtual-input events)\n\n"
+        "Emits a sequence of events, each being a tuple of the arguments accepted "
+        "by wlr-virtual-input-emit, e.g. [:motion 1 0]. Returns the number of events."
+    },
+    {
+        "wlr-virtual-input-emit-file", cfun_wlr_virtual_input_emit_file,
+        "(" MOD_NAME "/wlr-virtual-input-emit-file virtual-input path)\n\n"
+        "Like wlr-virtual-input-emit-batch, but reads the events from the file at path, "
+        "which contains one Janet tuple per event, e.g. [:key 38 :pressed]. Nothing is "
+        "emitted if the file can't be parsed. Returns the number of events."
+    },
+    {
+        "wlr-input-recorder-create", cfun_wlr_input_recorder_create,
+        "(" MOD_NAME "/wlr-input-recorder-create path wlr-cursor &opt capacity)\n\n"
+        "Starts recording the pointer events of wlr-cursor into a memory-mapped "
+        "log file at path, holding at most capacity (default 1048576) events. "
+        "Events beyond capacity are dropped. The recorder must be stopped before "
+        "the cursor gets destroyed."
+    },
+    {
+        "wlr-input-recorder-add-keyboard", cfun_wlr_input_recorder_add_keyboard,
+        "(" MOD_NAME "/wlr-input-recorder-add-keyboard recorder wlr-keyboard)\n\n"
+        "Also records the key events of wlr-keyboard."
+    },
+    {
+        "wlr-input-recorder-stop", cfun_wlr_input_recorder_stop,
+        "(" MOD_NAME "/wlr-input-recorder-stop recorder)\n\n"
+        "Stops recording and closes the log file. Returns the number of recorded events."
+    },
+    {
+        "wlr-input-replayer-create", cfun_wlr_input_replayer_create,
+        "(" MOD_NAME "/wlr-input-replayer-create wl-event-loop path pointer keyboard &opt mode on-done)\n\n"
+        "Replays an input log through the virtual input devices pointer and keyboard "
+        "(either can be nil, to skip its events). Mode is :realtime (the default), "
+        "which keeps the recorded timing, or :fast, which replays as fast as possible "
+        "in chunks between event loop iterations. (on-done completed) is called when "
+        "the replay ends."
+    },
+    {
+        "wlr-input-replayer-stop", cfun_wlr_input_replayer_stop,
+        "(" MOD_NAME "/wlr-input-replayer-stop replayer)\n\n"
+        "Stops a replay."
+    },
+    {
+        "wlr-trace-attach", cfun_wlr_trace_attach,
+        "(" MOD_NAME "/wlr-trace-attach trace-ring)\n\n"
+        "Starts recording output frames, scene commits, frame-done events and "
+        "animation ticks into a trace ring created by util/trace-ring-create. "
+        "Pass nil to stop."
+    },
+    {
+        "wlr-output-frame-stats-enable", cfun_wlr_output_frame_stats_enable,
+        "(" MOD_NAME "/wlr-output-frame-stats-enable wlr-output)\n\n"
+        "Starts collecting frame timing statistics for wlr-output. Only commits done "
+        "through wlr-scene-output-commit or an output frame handler are measured. "
+        "Returns false if the statistics are already enabled."
+    },
+    {
+        "wlr-output-frame-stats-disable", cfun_wlr_output_frame_stats_disable,
+        "(" MOD_NAME "/wlr-output-frame-stats-disable wlr-output)\n\n"
+        "Stops collecting frame timing statistics for wlr-output."
+    },
+    {
+        "wlr-output-frame-stats", cfun_wlr_output_frame_stats,
+        "(" MOD_NAME "/wlr-output-frame-stats wlr-output)\n\n"
+        "Returns the frame timing statistics of wlr-output, or nil if they're not "
+        "enabled. :latency covers the time from the frame event to the end of the "
+        "scene commit, and :commit the commit itself. Both are histograms, with "
+        "buckets bounded by :bounds-ms, plus one for anything slower."
+    },
+    {
+        "wlr-output-frame-stats-reset", cfun_wlr_output_frame_stats_reset,
+        "(" MOD_NAME "/wlr-output-frame-stats-reset wlr-output)\n\n"
+        "Resets the frame timing statistics of wlr-output."
+    },
     {
         "wlr-scene-node-reparent", cfun_wlr_scene_node_reparent,
         "(" MOD_NAME "/wlr-scene-node-reparent wlr-scene-node new-parent)\n\n"
@@ -4787,6 +9295,16 @@ static JanetReg cfuns[] = {
 JANET_MODULE_ENTRY(JanetTable *env)
 {
     janet_register_abstract_type(&jwlr_at_box);
+    janet_register_abstract_type(&jwlr_at_view_index);
+    janet_register_abstract_type(&jwlr_at_workspace);
+    janet_register_abstract_type(&jwlr_at_wlr_scene_rect);
+    janet_register_abstract_type(&jwlr_at_shm_buffer);
+    janet_register_abstract_type(&jwlr_at_animator);
+    janet_register_abstract_type(&jwlr_at_frame_throttle);
+    janet_register_abstract_type(&jwlr_at_output_frame_handler);
+    janet_register_abstract_type(&jwlr_at_virtual_input);
+    janet_register_abstract_type(&jwlr_at_input_recorder);
+    janet_register_abstract_type(&jwlr_at_input_replayer);
     janet_register_abstract_type(&jwlr_at_wlr_backend);
     janet_register_abstract_type(&jwlr_at_wlr_renderer);
     janet_register_abstract_type(&jwlr_at_wlr_allocator);
@@ -4812,6 +9330,8 @@ JANET_MODULE_ENTRY(JanetTable *env)
     janet_register_abstract_type(&jwlr_at_wlr_cursor);
     janet_register_abstract_type(&jwlr_at_wlr_xcursor_manager);
     janet_register_abstract_type(&jwlr_at_wlr_output);
+    janet_register_abstract_type(&jwlr_at_wlr_output_event_commit);
+    janet_register_abstract_type(&jwlr_at_wlr_buffer);
     janet_register_abstract_type(&jwlr_at_wlr_output_mode);
     janet_register_abstract_type(&jwlr_at_wlr_output_cursor);
     janet_register_abstract_type(&jwlr_at_wlr_input_device);
@@ -4835,5 +9355,5 @@ JANET_MODULE_ENTRY(JanetTable *env)
     janet_register_abstract_type(&jwlr_at_wlr_xwayland_minimize_event);
     janet_register_abstract_type(&jwlr_at_wlr_xwayland_surface_configure_event);
 
-    janet_cfuns(env, MOD_NAME, cfuns);
+    jl_cfuns(env, MOD_NAME, cfuns);
 }
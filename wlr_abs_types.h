@@ -15,13 +15,17 @@ static int method_wlr_abs_obj_compare(void *lhs, void *rhs);
 
 static int method_box_get(void *p, Janet key, Janet *out);
 static void method_box_put(void *p, Janet key, Janet value);
+static void method_box_marshal(void *p, JanetMarshalContext *ctx);
+static void *method_box_unmarshal(JanetMarshalContext *ctx);
 static const JanetAbstractType jwlr_at_box = {
     .name = MOD_NAME "/box",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_box_get,
     .put = method_box_put,
-    JANET_ATEND_PUT
+    .marshal = method_box_marshal,
+    .unmarshal = method_box_unmarshal,
+    JANET_ATEND_UNMARSHAL
 };
 
 
@@ -35,7 +39,7 @@ static const jl_offset_def_t wlr_backend_signal_offsets[] = {
 static int method_wlr_backend_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_backend = {
     .name = MOD_NAME "/wlr-backend",
-    .gc = NULL, /* TODO: close the backend? */
+    .gc = JL_STATS_GC, /* TODO: close the backend? */
     .gcmark = NULL,
     .get = method_wlr_backend_get,
     JANET_ATEND_GET
@@ -44,7 +48,7 @@ static const JanetAbstractType jwlr_at_wlr_backend = {
 
 static const JanetAbstractType jwlr_at_wlr_renderer = {
     .name = MOD_NAME "/wlr-renderer",
-    .gc = NULL, /* TODO: close the renderer? */
+    .gc = JL_STATS_GC, /* TODO: close the renderer? */
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -52,7 +56,7 @@ static const JanetAbstractType jwlr_at_wlr_renderer = {
 
 static const JanetAbstractType jwlr_at_wlr_allocator = {
     .name = MOD_NAME "/wlr-allocator",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -60,7 +64,7 @@ static const JanetAbstractType jwlr_at_wlr_allocator = {
 
 static const JanetAbstractType jwlr_at_wlr_compositor = {
     .name = MOD_NAME "/wlr-compositor",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -68,7 +72,7 @@ static const JanetAbstractType jwlr_at_wlr_compositor = {
 
 static const JanetAbstractType jwlr_at_wlr_subcompositor = {
     .name = MOD_NAME "/wlr-subcompositor",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -76,7 +80,7 @@ static const JanetAbstractType jwlr_at_wlr_subcompositor = {
 
 static const JanetAbstractType jwlr_at_wlr_data_device_manager = {
     .name = MOD_NAME "/wlr-data-device-manager",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -105,7 +109,7 @@ static const jl_offset_def_t wlr_output_layout_list_offsets[] = {
 static int method_wlr_output_layout_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_output_layout = {
     .name = MOD_NAME "/wlr-output-layout",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_output_layout_get,
     JANET_ATEND_GET
@@ -114,7 +118,7 @@ static const JanetAbstractType jwlr_at_wlr_output_layout = {
 
 static const JanetAbstractType jwlr_at_wlr_output_layout_output = {
     .name = MOD_NAME "/wlr-output-layout-output",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -127,7 +131,7 @@ static const jl_offset_def_t wlr_scene_list_offsets[] = {
 static int method_wlr_scene_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_scene = {
     .name = MOD_NAME "/wlr-scene",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_scene_get,
     JANET_ATEND_GET
@@ -142,7 +146,7 @@ static const jl_offset_def_t wlr_scene_output_signal_offsets[] = {
 static int method_wlr_scene_output_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_scene_output = {
     .name = MOD_NAME "/wlr-scene-output",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_scene_output_get,
     JANET_ATEND_GET
@@ -158,7 +162,7 @@ static const jl_offset_def_t wlr_xdg_shell_signal_offsets[] = {
 static int method_wlr_xdg_shell_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xdg_shell = {
     .name = MOD_NAME "/wlr-xdg-shell",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xdg_shell_get,
     JANET_ATEND_GET
@@ -177,7 +181,7 @@ static int method_wlr_surface_get(void *p, Janet key, Janet *out);
 static void method_wlr_surface_put(void *p, Janet key, Janet value);
 static const JanetAbstractType jwlr_at_wlr_surface = {
     .name = MOD_NAME "/wlr-surface",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_surface_get,
     .put = method_wlr_surface_put,
@@ -206,7 +210,7 @@ static const jl_key_def_t wlr_surface_state_field_defs[] = {
 static int method_wlr_surface_state_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_surface_state = {
     .name = MOD_NAME "/wlr-surface-state",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_surface_state_get,
     JANET_ATEND_GET
@@ -221,7 +225,7 @@ static const jl_offset_def_t wlr_xdg_popup_signal_offsets[] = {
 static int method_wlr_xdg_popup_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xdg_popup = {
     .name = MOD_NAME "/wlr-xdg-popup",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xdg_popup_get,
     JANET_ATEND_GET
@@ -244,7 +248,7 @@ static const jl_offset_def_t wlr_xdg_toplevel_signal_offsets[] = {
 static int method_wlr_xdg_toplevel_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xdg_toplevel = {
     .name = MOD_NAME "/wlr-xdg-toplevel",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xdg_toplevel_get,
     JANET_ATEND_GET
@@ -263,7 +267,7 @@ static const jl_key_def_t wlr_edges_defs[] = {
 static int method_wlr_xdg_toplevel_resize_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xdg_toplevel_resize_event = {
     .name = MOD_NAME "/wlr-xdg-toplevel-resize-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xdg_toplevel_resize_event_get,
     JANET_ATEND_GET
@@ -273,7 +277,7 @@ static const JanetAbstractType jwlr_at_wlr_xdg_toplevel_resize_event = {
 static int method_wlr_xdg_toplevel_move_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xdg_toplevel_move_event = {
     .name = MOD_NAME "/wlr-xdg-toplevel-move-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xdg_toplevel_move_event_get,
     JANET_ATEND_GET
@@ -308,7 +312,7 @@ static int method_wlr_xdg_surface_get(void *p, Janet key, Janet *out);
 static void method_wlr_xdg_surface_put(void *p, Janet key, Janet value);
 static const JanetAbstractType jwlr_at_wlr_xdg_surface = {
     .name = MOD_NAME "/wlr-xdg-surface",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xdg_surface_get,
     .put = method_wlr_xdg_surface_put,
@@ -355,7 +359,7 @@ static const jl_offset_def_t wlr_cursor_signal_offsets[] = {
 static int method_wlr_cursor_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_cursor = {
     .name = MOD_NAME "/wlr-cursor",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_cursor_get,
     JANET_ATEND_GET
@@ -364,7 +368,7 @@ static const JanetAbstractType jwlr_at_wlr_cursor = {
 
 static const JanetAbstractType jwlr_at_wlr_xcursor_manager = {
     .name = MOD_NAME "/wlr-xcursor-manager",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -373,7 +377,7 @@ static const JanetAbstractType jwlr_at_wlr_xcursor_manager = {
 static int method_wlr_xcursor_image_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xcursor_image = {
     .name = MOD_NAME "/wlr-xcursor-image",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xcursor_image_get,
     JANET_ATEND_GET
@@ -383,7 +387,7 @@ static const JanetAbstractType jwlr_at_wlr_xcursor_image = {
 static int method_wlr_xcursor_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xcursor = {
     .name = MOD_NAME "/wlr-xcursor",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xcursor_get,
     JANET_ATEND_GET
@@ -426,7 +430,7 @@ static const jl_offset_def_t wlr_seat_signal_offsets[] = {
 static int method_wlr_seat_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_seat = {
     .name = MOD_NAME "/wlr-seat",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_seat_get,
     JANET_ATEND_GET
@@ -435,7 +439,7 @@ static const JanetAbstractType jwlr_at_wlr_seat = {
 
 static const JanetAbstractType jwlr_at_wlr_seat_client = {
     .name = MOD_NAME "/wlr-seat-client",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = NULL,
     .put = NULL,
@@ -473,7 +477,7 @@ static int method_wlr_output_get(void *p, Janet key, Janet *out);
 static void method_wlr_output_put(void *p, Janet key, Janet value);
 static const JanetAbstractType jwlr_at_wlr_output = {
     .name = MOD_NAME "/wlr-output",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_output_get,
     .put = method_wlr_output_put,
@@ -481,6 +485,90 @@ static const JanetAbstractType jwlr_at_wlr_output = {
 };
 
 
+enum {
+    JWLR_VIRTUAL_EVENT_MOTION,
+    JWLR_VIRTUAL_EVENT_MOTION_ABSOLUTE,
+    JWLR_VIRTUAL_EVENT_BUTTON,
+    JWLR_VIRTUAL_EVENT_AXIS,
+    JWLR_VIRTUAL_EVENT_FRAME,
+    JWLR_VIRTUAL_EVENT_KEY,
+};
+
+static const jl_key_def_t virtual_input_event_defs[] = {
+    {"motion", JWLR_VIRTUAL_EVENT_MOTION},
+    {"motion-absolute", JWLR_VIRTUAL_EVENT_MOTION_ABSOLUTE},
+    {"button", JWLR_VIRTUAL_EVENT_BUTTON},
+    {"axis", JWLR_VIRTUAL_EVENT_AXIS},
+    {"frame", JWLR_VIRTUAL_EVENT_FRAME},
+    {"key", JWLR_VIRTUAL_EVENT_KEY},
+    {NULL, 0},
+};
+
+static int method_virtual_input_gc(void *p, size_t len);
+static int method_virtual_input_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_virtual_input = {
+    .name = MOD_NAME "/virtual-input",
+    .gc = method_virtual_input_gc,
+    .gcmark = NULL,
+    .get = method_virtual_input_get,
+    JANET_ATEND_GET
+};
+
+
+static int method_input_recorder_gc(void *p, size_t len);
+static int method_input_recorder_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_input_recorder = {
+    .name = MOD_NAME "/input-recorder",
+    .gc = method_input_recorder_gc,
+    .gcmark = NULL,
+    .get = method_input_recorder_get,
+    JANET_ATEND_GET
+};
+
+
+enum {
+    JWLR_INPUT_REPLAY_REALTIME,
+    JWLR_INPUT_REPLAY_FAST,
+};
+
+static const jl_key_def_t input_replay_mode_defs[] = {
+    {"realtime", JWLR_INPUT_REPLAY_REALTIME},
+    {"fast", JWLR_INPUT_REPLAY_FAST},
+    {NULL, 0},
+};
+
+static int method_input_replayer_gc(void *p, size_t len);
+static int method_input_replayer_gcmark(void *p, size_t len);
+static int method_input_replayer_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_input_replayer = {
+    .name = MOD_NAME "/input-replayer",
+    .gc = method_input_replayer_gc,
+    .gcmark = method_input_replayer_gcmark,
+    .get = method_input_replayer_get,
+    JANET_ATEND_GET
+};
+
+
+static int method_wlr_output_event_commit_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_wlr_output_event_commit = {
+    .name = MOD_NAME "/wlr-output-event-commit",
+    .gc = JL_STATS_GC,
+    .gcmark = NULL,
+    .get = method_wlr_output_event_commit_get,
+    JANET_ATEND_GET
+};
+
+
+static int method_wlr_buffer_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_wlr_buffer = {
+    .name = MOD_NAME "/wlr-buffer",
+    .gc = JL_STATS_GC,
+    .gcmark = NULL,
+    .get = method_wlr_buffer_get,
+    JANET_ATEND_GET
+};
+
+
 static const jl_key_def_t wlr_output_mode_aspect_ratio_defs[] = {
     {"none", WLR_OUTPUT_MODE_ASPECT_RATIO_NONE},
     {"4:3", WLR_OUTPUT_MODE_ASPECT_RATIO_4_3},
@@ -494,7 +582,7 @@ static const jl_key_def_t wlr_output_mode_aspect_ratio_defs[] = {
 static int method_wlr_output_mode_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_output_mode = {
     .name = MOD_NAME "/wlr-output-mode",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_output_mode_get,
     JANET_ATEND_GET
@@ -503,7 +591,7 @@ static const JanetAbstractType jwlr_at_wlr_output_mode = {
 
 static const JanetAbstractType jwlr_at_wlr_output_cursor = {
     .name = MOD_NAME "/wlr-output-cursor",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -517,7 +605,7 @@ static const jl_offset_def_t wlr_scene_tree_list_offsets[] = {
 static int method_wlr_scene_tree_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_scene_tree = {
     .name = MOD_NAME "/wlr-scene-tree",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_scene_tree_get,
     JANET_ATEND_GET
@@ -537,11 +625,32 @@ static const jl_offset_def_t wlr_scene_node_signal_offsets[] = {
     {NULL, 0},
 };
 
+enum {
+    JWLR_SCENE_OP_SET_POSITION,
+    JWLR_SCENE_OP_SET_ENABLED,
+    JWLR_SCENE_OP_RAISE_TO_TOP,
+    JWLR_SCENE_OP_LOWER_TO_BOTTOM,
+    JWLR_SCENE_OP_PLACE_ABOVE,
+    JWLR_SCENE_OP_PLACE_BELOW,
+    JWLR_SCENE_OP_REPARENT,
+};
+
+static const jl_key_def_t wlr_scene_op_defs[] = {
+    {"set-position", JWLR_SCENE_OP_SET_POSITION},
+    {"set-enabled", JWLR_SCENE_OP_SET_ENABLED},
+    {"raise-to-top", JWLR_SCENE_OP_RAISE_TO_TOP},
+    {"lower-to-bottom", JWLR_SCENE_OP_LOWER_TO_BOTTOM},
+    {"place-above", JWLR_SCENE_OP_PLACE_ABOVE},
+    {"place-below", JWLR_SCENE_OP_PLACE_BELOW},
+    {"reparent", JWLR_SCENE_OP_REPARENT},
+    {NULL, 0},
+};
+
 static int method_wlr_scene_node_get(void *p, Janet key, Janet *out);
 static void method_wlr_scene_node_put(void *p, Janet key, Janet value);
 static const JanetAbstractType jwlr_at_wlr_scene_node = {
     .name = MOD_NAME "/wlr-scene-node",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_scene_node_get,
     .put = method_wlr_scene_node_put,
@@ -552,9 +661,23 @@ static const JanetAbstractType jwlr_at_wlr_scene_node = {
 };
 
 
+static int method_wlr_scene_rect_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_wlr_scene_rect = {
+    .name = MOD_NAME "/wlr-scene-rect",
+    .gc = JL_STATS_GC,
+    .gcmark = NULL,
+    .get = method_wlr_scene_rect_get,
+    .put = NULL,
+    .marshal = NULL,
+    .unmarshal = NULL,
+    .tostring = method_wlr_abs_obj_tostring,
+    JANET_ATEND_TOSTRING
+};
+
+
 static const JanetAbstractType jwlr_at_wlr_scene_buffer = {
     .name = MOD_NAME "/wlr-scene-buffer",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -563,13 +686,99 @@ static const JanetAbstractType jwlr_at_wlr_scene_buffer = {
 static int method_wlr_scene_surface_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_scene_surface = {
     .name = MOD_NAME "/wlr-scene-surface",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_scene_surface_get,
     JANET_ATEND_GET
 };
 
 
+static int method_workspace_gc(void *p, size_t len);
+static int method_workspace_gcmark(void *p, size_t len);
+static int method_workspace_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_workspace = {
+    .name = MOD_NAME "/workspace",
+    .gc = method_workspace_gc,
+    .gcmark = method_workspace_gcmark,
+    .get = method_workspace_get,
+    JANET_ATEND_GET
+};
+
+
+static int method_shm_buffer_gc(void *p, size_t len);
+static int method_shm_buffer_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_shm_buffer = {
+    .name = MOD_NAME "/shm-buffer",
+    .gc = method_shm_buffer_gc,
+    .get = method_shm_buffer_get,
+    JANET_ATEND_GET
+};
+
+
+enum {
+    JWLR_EASING_LINEAR,
+    JWLR_EASING_EASE_IN,
+    JWLR_EASING_EASE_OUT,
+    JWLR_EASING_EASE_IN_OUT,
+};
+
+static const jl_key_def_t animation_easing_defs[] = {
+    {"linear", JWLR_EASING_LINEAR},
+    {"ease-in", JWLR_EASING_EASE_IN},
+    {"ease-out", JWLR_EASING_EASE_OUT},
+    {"ease-in-out", JWLR_EASING_EASE_IN_OUT},
+    {NULL, 0},
+};
+
+enum {
+    JWLR_ANIMATION_POSITION,
+    JWLR_ANIMATION_SIZE,
+};
+
+static const jl_key_def_t animation_property_defs[] = {
+    {"position", JWLR_ANIMATION_POSITION},
+    {"size", JWLR_ANIMATION_SIZE},
+    {NULL, 0},
+};
+
+static int method_animator_gcmark(void *p, size_t len);
+static const JanetAbstractType jwlr_at_animator = {
+    .name = MOD_NAME "/animator",
+    .gc = JL_STATS_GC,
+    .gcmark = method_animator_gcmark,
+    JANET_ATEND_GCMARK
+};
+
+
+static int method_frame_throttle_get(void *p, Janet key, Janet *out);
+static const JanetAbstractType jwlr_at_frame_throttle = {
+    .name = MOD_NAME "/frame-throttle",
+    .gc = JL_STATS_GC,
+    .gcmark = NULL,
+    .get = method_frame_throttle_get,
+    JANET_ATEND_GET
+};
+
+
+static int method_output_frame_handler_gcmark(void *p, size_t len);
+static const JanetAbstractType jwlr_at_output_frame_handler = {
+    .name = MOD_NAME "/output-frame-handler",
+    .gc = JL_STATS_GC,
+    .gcmark = method_output_frame_handler_gcmark,
+    JANET_ATEND_GCMARK
+};
+
+
+static int method_view_index_gc(void *p, size_t len);
+static int method_view_index_gcmark(void *p, size_t len);
+static const JanetAbstractType jwlr_at_view_index = {
+    .name = MOD_NAME "/view-index",
+    .gc = method_view_index_gc,
+    .gcmark = method_view_index_gcmark,
+    JANET_ATEND_GCMARK
+};
+
+
 static const jl_key_def_t wlr_input_device_defs[] = {
     {"keyboard", WLR_INPUT_DEVICE_KEYBOARD},
     {"pointer", WLR_INPUT_DEVICE_POINTER},
@@ -589,7 +798,7 @@ static const jl_offset_def_t wlr_input_device_signal_offsets[] = {
 static int method_wlr_input_device_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_input_device = {
     .name = MOD_NAME "/wlr-input-device",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_input_device_get,
     .put = NULL,
@@ -621,7 +830,7 @@ static const jl_offset_def_t wlr_pointer_signal_offsets[] = {
 static int method_wlr_pointer_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_pointer = {
     .name = MOD_NAME "/wlr-pointer",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_pointer_get,
     JANET_ATEND_GET
@@ -631,7 +840,7 @@ static const JanetAbstractType jwlr_at_wlr_pointer = {
 static int method_wlr_pointer_motion_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_pointer_motion_event = {
     .name = MOD_NAME "/wlr-pointer-motion-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_pointer_motion_event_get,
     JANET_ATEND_GET
@@ -641,7 +850,7 @@ static const JanetAbstractType jwlr_at_wlr_pointer_motion_event = {
 static int method_wlr_pointer_motion_absolute_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_pointer_motion_absolute_event = {
     .name = MOD_NAME "/wlr-pointer-motion-absolute-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_pointer_motion_absolute_event_get,
     JANET_ATEND_GET
@@ -658,7 +867,7 @@ static const jl_key_def_t wlr_button_state_defs[] = {
 static int method_wlr_pointer_button_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_pointer_button_event = {
     .name = MOD_NAME "/wlr-pointer-button-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_pointer_button_event_get,
     JANET_ATEND_GET
@@ -684,7 +893,7 @@ static const jl_key_def_t wlr_axis_orientation_defs[] = {
 static int method_wlr_pointer_axis_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_pointer_axis_event = {
     .name = MOD_NAME "/wlr-pointer-axis-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_pointer_axis_event_get,
     JANET_ATEND_GET
@@ -699,7 +908,7 @@ static const jl_offset_def_t wlr_seat_pointer_state_signal_offsets[] = {
 static int method_wlr_seat_pointer_state_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_seat_pointer_state = {
     .name = MOD_NAME "/wlr-seat-pointer-state",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_seat_pointer_state_get,
     JANET_ATEND_GET
@@ -714,7 +923,7 @@ static const jl_offset_def_t wlr_seat_keyboard_state_signal_offsets[] = {
 static int method_wlr_seat_keyboard_state_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_seat_keyboard_state = {
     .name = MOD_NAME "/wlr-seat-keyboard-state",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_seat_keyboard_state_get,
     JANET_ATEND_GET
@@ -724,7 +933,7 @@ static const JanetAbstractType jwlr_at_wlr_seat_keyboard_state = {
 static int method_wlr_seat_pointer_request_set_cursor_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_seat_pointer_request_set_cursor_event = {
     .name = MOD_NAME "/wlr-seat-pointer-request-set-cursor-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_seat_pointer_request_set_cursor_event_get,
     JANET_ATEND_GET
@@ -734,7 +943,7 @@ static const JanetAbstractType jwlr_at_wlr_seat_pointer_request_set_cursor_event
 static int method_wlr_seat_request_set_selection_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_seat_request_set_selection_event = {
     .name = MOD_NAME "/wlr-seat-request-set-selection-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_seat_request_set_selection_event_get,
     JANET_ATEND_GET
@@ -743,7 +952,7 @@ static const JanetAbstractType jwlr_at_wlr_seat_request_set_selection_event = {
 
 static const JanetAbstractType jwlr_at_wlr_data_source = {
     .name = MOD_NAME "/wlr-data-source",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -764,7 +973,7 @@ static const jl_key_def_t wlr_keyboard_modifier_defs[] = {
 static int method_wlr_keyboard_modifiers_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_keyboard_modifiers = {
     .name = MOD_NAME "/wlr-keyboard-modifiers",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_keyboard_modifiers_get,
     JANET_ATEND_GET
@@ -780,7 +989,7 @@ static const jl_key_def_t wl_keyboard_key_state_defs[] = {
 static int method_wlr_keyboard_key_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_keyboard_key_event = {
     .name = MOD_NAME "/wlr-keyboard-key-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_keyboard_key_event_get,
     JANET_ATEND_GET
@@ -798,7 +1007,7 @@ static const jl_offset_def_t wlr_keyboard_signal_offsets[] = {
 static int method_wlr_keyboard_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_keyboard = {
     .name = MOD_NAME "/wlr-keyboard",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_keyboard_get,
     JANET_ATEND_GET
@@ -815,7 +1024,7 @@ static const jl_offset_def_t wlr_xwayland_signal_offsets[] = {
 static int method_wlr_xwayland_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xwayland = {
     .name = MOD_NAME "/wlr-xwayland",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xwayland_get,
     JANET_ATEND_GET
@@ -859,7 +1068,7 @@ static int method_wlr_xwayland_surface_get(void *p, Janet key, Janet *out);
 static void method_wlr_xwayland_surface_put(void *p, Janet key, Janet value);
 static const JanetAbstractType jwlr_at_wlr_xwayland_surface = {
     .name = MOD_NAME "/wlr-xwayland-surface",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xwayland_surface_get,
     .put = method_wlr_xwayland_surface_put,
@@ -873,7 +1082,7 @@ static const JanetAbstractType jwlr_at_wlr_xwayland_surface = {
 static int method_wlr_xwayland_resize_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xwayland_resize_event = {
     .name = MOD_NAME "/wlr-xwayland-resize-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xwayland_resize_event_get,
     JANET_ATEND_GET
@@ -883,7 +1092,7 @@ static const JanetAbstractType jwlr_at_wlr_xwayland_resize_event = {
 static int method_wlr_xwayland_minimize_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xwayland_minimize_event = {
     .name = MOD_NAME "/wlr-xwayland-minimize-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xwayland_minimize_event_get,
     JANET_ATEND_GET
@@ -893,7 +1102,7 @@ static const JanetAbstractType jwlr_at_wlr_xwayland_minimize_event = {
 static int method_wlr_xwayland_surface_configure_event_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_xwayland_surface_configure_event = {
     .name = MOD_NAME "/wlr-xwayland-surface-configure-event",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_xwayland_surface_configure_event_get,
     JANET_ATEND_GET
@@ -909,7 +1118,7 @@ static const jl_offset_def_t wlr_layer_shell_v1_signal_offsets[] = {
 static int method_wlr_layer_shell_v1_get(void *p, Janet key, Janet *out);
 static const JanetAbstractType jwlr_at_wlr_layer_shell_v1 = {
     .name = MOD_NAME "/wlr-layer-shell-v1",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_wlr_layer_shell_v1_get,
     JANET_ATEND_GET
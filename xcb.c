@@ -16,7 +16,7 @@
 
 static const JanetAbstractType jxcb_at_intern_atom_cookie_t = {
     .name = MOD_NAME "/intern-atom-cookie-t",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -25,6 +25,7 @@ static const JanetAbstractType jxcb_at_intern_atom_cookie_t = {
 static int method_xcb_intern_atom_reply_t_gc(void *data, size_t len)
 {
     (void)len;
+    JL_STATS_COUNT_GC(data);
     xcb_intern_atom_reply_t **reply_p = data;
     xcb_intern_atom_reply_t *reply = *reply_p;
     free(reply);
@@ -64,6 +65,7 @@ static const JanetAbstractType jxcb_at_xcb_intern_atom_reply_t = {
 static int method_xcb_generic_error_t_gc(void *data, size_t len)
 {
     (void)len;
+    JL_STATS_COUNT_GC(data);
     xcb_generic_error_t **error_p = data;
     xcb_generic_error_t *error = *error_p;
     free(error);
@@ -114,7 +116,7 @@ static const jl_key_def_t xcb_conn_error_defs[] = {
 
 static const JanetAbstractType jxcb_at_xcb_connection_t = {
     .name = MOD_NAME "/xcb-connection-t",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -311,7 +313,7 @@ static int method_xcb_size_hints_t_get(void *p, Janet key, Janet *out)
 
 static const JanetAbstractType jxcb_at_xcb_size_hints_t = {
     .name = MOD_NAME "/xcb-size-hints-t",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     .get = method_xcb_size_hints_t_get,
     JANET_ATEND_GET
@@ -441,5 +443,5 @@ JANET_MODULE_ENTRY(JanetTable *env)
     janet_register_abstract_type(&jxcb_at_xcb_intern_atom_reply_t);
     janet_register_abstract_type(&jxcb_at_xcb_size_hints_t);
 
-    janet_cfuns(env, MOD_NAME, cfuns);
+    jl_cfuns(env, MOD_NAME, cfuns);
 }
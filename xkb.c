@@ -20,7 +20,7 @@ static const jl_key_def_t xkb_context_flags_defs[] = {
 
 static const JanetAbstractType jxkb_at_xkb_context = {
     .name = MOD_NAME "/xkb-context",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -82,7 +82,7 @@ static int method_xkb_rule_names_gcmark(void *p, size_t len)
 
 static const JanetAbstractType jxkb_at_xkb_rule_names = {
     .name = MOD_NAME "/xkb-rule-names",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = method_xkb_rule_names_gcmark,
     JANET_ATEND_GCMARK
 };
@@ -140,7 +140,7 @@ static const jl_key_def_t xkb_keymap_compile_flags_defs[] = {
 
 static const JanetAbstractType jxkb_at_xkb_keymap = {
     .name = MOD_NAME "/xkb-keymap",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -187,7 +187,7 @@ static Janet cfun_xkb_keymap_unref(int32_t argc, Janet *argv)
 
 static const JanetAbstractType jxkb_at_xkb_state = {
     .name = MOD_NAME "/xkb-state",
-    .gc = NULL,
+    .gc = JL_STATS_GC,
     .gcmark = NULL,
     JANET_ATEND_GCMARK
 };
@@ -260,5 +260,5 @@ JANET_MODULE_ENTRY(JanetTable *env)
     janet_register_abstract_type(&jxkb_at_xkb_rule_names);
     janet_register_abstract_type(&jxkb_at_xkb_state);
 
-    janet_cfuns(env, MOD_NAME, cfuns);
+    jl_cfuns(env, MOD_NAME, cfuns);
 }